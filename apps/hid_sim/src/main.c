@@ -0,0 +1,635 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sysinit/sysinit.h"
+#include "os/mynewt.h"
+#include "nimble/ble.h"
+#include "host/ble_store.h"
+#include "nimble-hid/nimble-hid.h"
+#if MYNEWT_VAL(BLE_HID_BENCH)
+#include "nimble-hid/hid_bench.h"
+#endif
+#include "sim.h"
+
+/*
+   Scripted session against the fake centrals in sim_ctlr.c, which are
+   bonded already.  Every link is encrypted with the stored bond.  The
+   sim starts as a wake from System OFF with host slot 1 in retained RAM,
+   so the second central answers the directed advertising at boot while
+   a cold boot would go to slot 0:
+
+   1. keys typed before the link exists, they must be replayed once the
+      central subscribes.  The first one stands for the key that woke the
+      board, pressed when main() starts it has to reach the central
+      within SIM_WAKE_BUDGET_MS;
+   2. paced keystrokes, latency from hid_send_keyboard_report() to the
+      notification reaching the controller;
+   3. the same in boot protocol mode;
+   4. a burst with a few reports in flight, delivered reports per second;
+   5. a switch to host slot 0, the first central.  The first report has
+      to reach it within SIM_SWITCH_BUDGET_MS of ble_hid_host_switch();
+   6. link loss with the central in range: the keyboard has to reconnect
+      from high duty directed advertising within SIM_DIRECTED_BUDGET_MS,
+      the central answers advertising after 10 ms;
+   7. link loss, the central now ignores directed advertising.  The
+      keyboard has to fall through both directed phases to undirected
+      advertising and deliver paced keystrokes again.
+
+   With BLE_HID_BENCH (targets/hid_sim_bench) the hidbench runs follow
+   a passing script.  Each run prints one JSON object on a line of its
+   own, prefixed with "hidbench: ".
+
+   The air interface is not modelled: latency is the host and HID stack
+   cost only and throughput is bound by the CPU, not the connection
+   interval.  The process exits with 1 if a report went missing.
+ */
+
+#define SIM_PRE_LINK_REPORTS    4
+#define SIM_PACED_REPORTS       50
+#define SIM_BOOT_REPORTS        10
+#define SIM_BURST_REPORTS       200
+#define SIM_BURST_WINDOW        4
+#define SIM_SWITCH_REPORTS      10
+#define SIM_DIRECTED_REPORTS    10
+#define SIM_RECONNECT_REPORTS   10
+#define SIM_PACE_MS             20
+#define SIM_TIMEOUT_MS          10000
+#define SIM_WAKE_BUDGET_MS      100
+#define SIM_DIRECTED_BUDGET_MS  50
+#define SIM_SWITCH_BUDGET_MS    100
+#define SIM_BENCH_ITERS         1000
+#define SIM_BENCH_SEND_REPORTS  1000
+#define SIM_BENCH_TIMEOUT_MS    30000
+#define SIM_BENCH_LINE          4096
+#define SIM_MATRIX_ROWS         6
+#define SIM_MATRIX_COLS         18
+
+static struct os_task sim_task;
+static os_stack_t sim_stack[MYNEWT_VAL(HID_SIM_TASK_STACK_SIZE)];
+static struct os_eventq sim_evq;
+
+static struct os_callout sim_step_timer;
+static struct os_callout sim_timeout_timer;
+
+static enum {
+    PHASE_PRE_LINK,
+    PHASE_PACED,
+    PHASE_BOOT,
+    PHASE_BURST,
+    PHASE_SWITCH,
+    PHASE_DIRECTED,
+    PHASE_RECONNECT,
+    PHASE_DONE,
+} sim_phase;
+
+static bool sim_subscribed;
+/* the key that woke the board, to its report reaching the central */
+static struct timespec sim_wake_ts;
+static uint32_t sim_wake_us;
+/* peer of the boot connection */
+static ble_addr_t sim_boot_peer;
+/* first connection to its first report */
+static uint32_t sim_conn_report_us;
+static uint32_t sim_link_loss_ts;
+static uint32_t sim_reconnect_ms;
+/* connections made from high duty directed advertising */
+static bool sim_boot_hd_directed;
+static bool sim_directed_hd_directed;
+static uint32_t sim_directed_loss_ts;
+static uint32_t sim_directed_us;
+static int sim_connections;
+/* ble_hid_host_switch() to the new host's connection and first report */
+static uint32_t sim_switch_ts;
+static uint32_t sim_switch_conn_us;
+static uint32_t sim_switch_us;
+
+static struct {
+    const char *name;
+    int expected;
+    int sent;
+    int received;
+    uint32_t lat_min;
+    uint32_t lat_max;
+    uint64_t lat_sum;
+    uint32_t first_ts;
+    uint32_t last_ts;
+} sim_results[PHASE_DONE] = {
+    [PHASE_PRE_LINK] = { "pre-link", SIM_PRE_LINK_REPORTS },
+    [PHASE_PACED] = { "paced", SIM_PACED_REPORTS },
+    [PHASE_BOOT] = { "boot", SIM_BOOT_REPORTS },
+    [PHASE_BURST] = { "burst", SIM_BURST_REPORTS },
+    [PHASE_SWITCH] = { "switch", SIM_SWITCH_REPORTS },
+    [PHASE_DIRECTED] = { "directed", SIM_DIRECTED_REPORTS },
+    [PHASE_RECONNECT] = { "reconnect", SIM_RECONNECT_REPORTS },
+};
+
+/* send times of reports not yet seen by the central, in order */
+static uint32_t sim_sent_ts[SIM_BURST_REPORTS];
+static int sim_sent_head;
+static int sim_sent_tail;
+
+/* wall clock, the cputime is not running yet when the key is pressed */
+static uint32_t
+sim_us_since(const struct timespec *from)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - from->tv_sec) * 1000000 +
+           (now.tv_nsec - from->tv_nsec) / 1000;
+}
+
+static void
+sim_type(void)
+{
+    uint8_t report[8] = { 0 };
+    int n = sim_results[sim_phase].sent;
+    int rc;
+
+    /* alternating press of 'a'..'z' and release */
+    if ((n & 1) == 0) {
+        report[2] = 0x04 + (n / 2) % 26;
+    }
+
+    sim_sent_ts[sim_sent_head++ % SIM_BURST_REPORTS] = os_cputime_get32();
+    sim_results[sim_phase].sent++;
+
+    rc = hid_send_keyboard_report(report, sizeof(report));
+    if (rc != 0) {
+        printf("sim: report %d of %s not sent, rc=%d\n", n,
+               sim_results[sim_phase].name, rc);
+    }
+}
+
+#if MYNEWT_VAL(BLE_HID_BENCH)
+static struct os_event sim_bench_ev;
+static int sim_bench_step;
+
+/* the current run's JSON, printed as one line once it is complete */
+static char sim_bench_line[SIM_BENCH_LINE];
+static int sim_bench_len;
+
+/* HID usage of every switch, the last row holds the modifiers */
+static uint8_t sim_keymap[SIM_MATRIX_ROWS][SIM_MATRIX_COLS];
+
+static int
+sim_bench_out(const char *fmt, ...)
+{
+    va_list ap;
+    int len;
+
+    va_start(ap, fmt);
+    len = vsnprintf(sim_bench_line + sim_bench_len,
+                    sizeof(sim_bench_line) - sim_bench_len, fmt, ap);
+    va_end(ap);
+    assert(len >= 0 && sim_bench_len + len < sizeof(sim_bench_line));
+    sim_bench_len += len;
+
+    if (sim_bench_len && sim_bench_line[sim_bench_len - 1] == '\n') {
+        printf("hidbench: %s", sim_bench_line);
+        sim_bench_len = 0;
+    }
+    return len;
+}
+
+/*
+   Same as matrix_to_report of apps/keyboard (bench.c): the keymap
+   lookup of one switch, walking the whole board, and the report handed
+   to nimble-hid.  tmk is not part of the sim, the keymap is a plain
+   table of usages here.
+ */
+static void
+sim_bench_matrix_report(uint32_t i, void *arg)
+{
+    uint8_t report[8] = { 0 };
+    uint8_t code;
+
+    code = sim_keymap[i % SIM_MATRIX_ROWS][(i / SIM_MATRIX_ROWS) % SIM_MATRIX_COLS];
+    if (code >= 0xe0) {
+        report[0] |= 1 << (code - 0xe0);
+    } else if (code != 0) {
+        report[2] = code;
+    }
+
+    hid_send_keyboard_report(report, sizeof(report));
+}
+
+static struct hid_bench_op sim_bench_matrix_op = {
+    .name = "matrix_to_report",
+    .fn = sim_bench_matrix_report,
+};
+
+/* called in the HID task when a run is done */
+static void
+sim_bench_done(void)
+{
+    os_eventq_put(&sim_evq, &sim_bench_ev);
+}
+
+/* the hidbench runs one after the other, then exit */
+static void
+sim_bench_next(struct os_event *ev)
+{
+    int rc;
+
+    if (sim_bench_step == 0) {
+        os_callout_reset(&sim_timeout_timer,
+                         os_time_ms_to_ticks32(SIM_BENCH_TIMEOUT_MS));
+        hid_bench_set_output(sim_bench_out);
+    }
+
+    switch (sim_bench_step++) {
+    case 0:
+        rc = hid_bench_run(SIM_BENCH_ITERS, sim_bench_done);
+        break;
+    case 1:
+        rc = hid_bench_replay(sim_bench_done);
+        break;
+    case 2:
+        rc = hid_bench_send(SIM_BENCH_SEND_REPORTS, sim_bench_done);
+        break;
+    default:
+        exit(0);
+    }
+    if (rc != 0) {
+        printf("sim: bench %d not started, rc=%d\n", sim_bench_step - 1, rc);
+        exit(1);
+    }
+}
+
+static void
+sim_bench_init(void)
+{
+    int row;
+    int col;
+
+    for (row = 0; row < SIM_MATRIX_ROWS; ++row) {
+        for (col = 0; col < SIM_MATRIX_COLS; ++col) {
+            if (row == SIM_MATRIX_ROWS - 1) {
+                sim_keymap[row][col] = col < 8 ? 0xe0 + col : 0;
+            } else {
+                sim_keymap[row][col] = 0x04 + (row * SIM_MATRIX_COLS + col) % 0x60;
+            }
+        }
+    }
+    hid_bench_op_register(&sim_bench_matrix_op);
+    sim_bench_ev.ev_cb = sim_bench_next;
+}
+#endif
+
+static void
+sim_summary(void)
+{
+    bool fail = false;
+    bool wake_host;
+    uint32_t usecs;
+    int map_len;
+    int map_reads;
+    int i;
+
+    printf("\n%-10s %5s %5s %8s %8s %8s\n",
+           "phase", "sent", "recv", "min us", "avg us", "max us");
+    for (i = 0; i < PHASE_DONE; ++i) {
+        printf("%-10s %5d %5d", sim_results[i].name,
+               sim_results[i].sent, sim_results[i].received);
+        if (sim_results[i].received) {
+            printf(" %8lu %8lu %8lu",
+                   (unsigned long)sim_results[i].lat_min,
+                   (unsigned long)(sim_results[i].lat_sum /
+                                   sim_results[i].received),
+                   (unsigned long)sim_results[i].lat_max);
+        }
+        printf("\n");
+
+        if (sim_results[i].received != sim_results[i].expected) {
+            fail = true;
+        }
+    }
+
+    usecs = os_cputime_ticks_to_usecs(sim_results[PHASE_BURST].last_ts -
+                                      sim_results[PHASE_BURST].first_ts);
+    if (usecs) {
+        printf("burst: %lu reports/s\n", (unsigned long)
+               ((uint64_t)sim_results[PHASE_BURST].received * 1000000 / usecs));
+    }
+    usecs = sim_ctlr_discovery_time(&map_len, &map_reads);
+    printf("discovery: %lu us, report map %d bytes in %d reads\n",
+           (unsigned long)usecs, map_len, map_reads);
+    printf("first report %lu us after connect\n",
+           (unsigned long)sim_conn_report_us);
+    printf("links encrypted: %d of %d\n", sim_ctlr_encrypted(), sim_connections);
+    if (sim_ctlr_encrypted() != sim_connections) {
+        fail = true;
+    }
+    printf("host switch: connected after %lu us, first report after %lu us, "
+           "budget %d ms\n", (unsigned long)sim_switch_conn_us,
+           (unsigned long)sim_switch_us, SIM_SWITCH_BUDGET_MS);
+    if (sim_switch_us == 0 || sim_switch_us > SIM_SWITCH_BUDGET_MS * 1000) {
+        fail = true;
+    }
+    printf("boot connection from %s advertising\n",
+           sim_boot_hd_directed ? "directed" : "other");
+    printf("directed reconnect: %lu us, budget %d ms\n",
+           (unsigned long)sim_directed_us, SIM_DIRECTED_BUDGET_MS);
+    if (!sim_boot_hd_directed || !sim_directed_hd_directed ||
+        sim_directed_us == 0 || sim_directed_us > SIM_DIRECTED_BUDGET_MS * 1000) {
+        fail = true;
+    }
+    printf("reconnect without directed answer: %lu ms\n",
+           (unsigned long)sim_reconnect_ms);
+    wake_host = memcmp(sim_boot_peer.val, SIM_CENTRAL2_ADDR, 6) == 0;
+    printf("wake to %s host: first report %lu us after the key, "
+           "budget %d ms\n", wake_host ? "retained" : "wrong",
+           (unsigned long)sim_wake_us, SIM_WAKE_BUDGET_MS);
+    printf("first report %lu ms after boot\n",
+           (unsigned long)hid_boot_report_time());
+    if (!wake_host || sim_wake_us == 0 ||
+        sim_wake_us > SIM_WAKE_BUDGET_MS * 1000) {
+        fail = true;
+    }
+    printf("%s\n", fail ? "FAIL" : "PASS");
+
+#if MYNEWT_VAL(BLE_HID_BENCH)
+    if (!fail && sim_phase == PHASE_DONE) {
+        sim_bench_next(NULL);
+        return;
+    }
+#endif
+    exit(fail ? 1 : 0);
+}
+
+static void
+sim_next_phase(void)
+{
+    int rc;
+
+    if (sim_phase == PHASE_PRE_LINK) {
+        sim_conn_report_us = hid_conn_report_time();
+    }
+    sim_phase++;
+    sim_sent_head = sim_sent_tail = 0;
+
+    switch (sim_phase) {
+    case PHASE_BOOT:
+        sim_ctlr_set_protocol_mode(0);
+        break;
+    case PHASE_BURST:
+        sim_ctlr_set_protocol_mode(1);
+        break;
+    case PHASE_SWITCH:
+        /* typing resumes once the first central subscribed */
+        sim_switch_ts = os_cputime_get32();
+        rc = ble_hid_host_switch(0);
+        assert(rc == 0);
+        return;
+    case PHASE_DIRECTED:
+        sim_directed_loss_ts = os_cputime_get32();
+        sim_ctlr_link_loss(true);
+        return;
+    case PHASE_RECONNECT:
+        sim_link_loss_ts = os_time_get();
+        sim_ctlr_link_loss(false);
+        return;
+    case PHASE_DONE:
+        sim_summary();
+        return;
+    default:
+        break;
+    }
+
+    /* give the protocol mode write a moment to land */
+    os_callout_reset(&sim_step_timer, os_time_ms_to_ticks32(SIM_PACE_MS));
+}
+
+static void
+sim_step(struct os_event *ev)
+{
+    int i;
+
+    switch (sim_phase) {
+    case PHASE_PACED:
+    case PHASE_BOOT:
+    case PHASE_SWITCH:
+    case PHASE_DIRECTED:
+    case PHASE_RECONNECT:
+        if (sim_results[sim_phase].sent < sim_results[sim_phase].expected) {
+            sim_type();
+            os_callout_reset(&sim_step_timer,
+                             os_time_ms_to_ticks32(SIM_PACE_MS));
+        }
+        break;
+    case PHASE_BURST:
+        for (i = 0; i < SIM_BURST_WINDOW; ++i) {
+            sim_type();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void
+sim_timeout(struct os_event *ev)
+{
+    if (sim_phase == PHASE_DONE) {
+        printf("sim: timed out in the benchmarks\n");
+        exit(1);
+    }
+    printf("sim: timed out in %s\n", sim_results[sim_phase].name);
+    sim_summary();
+}
+
+void
+sim_on_connected(bool hd_directed, const ble_addr_t *peer)
+{
+    sim_connections++;
+
+    switch (sim_phase) {
+    case PHASE_PRE_LINK:
+        sim_boot_hd_directed = hd_directed;
+        sim_boot_peer = *peer;
+        break;
+    case PHASE_SWITCH:
+        sim_switch_conn_us = os_cputime_ticks_to_usecs(os_cputime_get32() -
+                                                       sim_switch_ts);
+        break;
+    case PHASE_DIRECTED:
+        sim_directed_hd_directed = hd_directed;
+        sim_directed_us = os_cputime_ticks_to_usecs(os_cputime_get32() -
+                                                    sim_directed_loss_ts);
+        break;
+    default:
+        break;
+    }
+}
+
+void
+sim_on_subscribed(void)
+{
+    printf("sim: central subscribed\n");
+    if (sim_phase == PHASE_SWITCH) {
+        /* the switch is timed to the first report, type right away */
+        os_callout_reset(&sim_step_timer, 0);
+        return;
+    }
+    if (sim_phase == PHASE_DIRECTED) {
+        os_callout_reset(&sim_step_timer, os_time_ms_to_ticks32(SIM_PACE_MS));
+        return;
+    }
+    if (sim_phase == PHASE_RECONNECT) {
+        sim_reconnect_ms = os_time_ticks_to_ms32(os_time_get() - sim_link_loss_ts);
+        os_callout_reset(&sim_step_timer, os_time_ms_to_ticks32(SIM_PACE_MS));
+        return;
+    }
+    sim_subscribed = true;
+    /* the pre-link reports are replayed from the pending queue */
+    if (sim_results[PHASE_PRE_LINK].received ==
+        sim_results[PHASE_PRE_LINK].expected) {
+        sim_next_phase();
+    }
+}
+
+void
+sim_on_notify(uint16_t attr_handle, const uint8_t *data, int len, uint32_t ts)
+{
+    uint32_t lat;
+
+    if (len != 8 || sim_phase == PHASE_DONE) {
+        /* battery, consumer control */
+        return;
+    }
+
+    if (sim_sent_tail == sim_sent_head) {
+        printf("sim: unexpected report on handle %d\n", attr_handle);
+        return;
+    }
+
+    lat = os_cputime_ticks_to_usecs(ts -
+              sim_sent_ts[sim_sent_tail++ % SIM_BURST_REPORTS]);
+    if (sim_results[sim_phase].received == 0) {
+        if (sim_phase == PHASE_PRE_LINK) {
+            sim_wake_us = sim_us_since(&sim_wake_ts);
+        }
+        sim_results[sim_phase].lat_min = lat;
+        sim_results[sim_phase].first_ts = ts;
+        if (sim_phase == PHASE_SWITCH) {
+            sim_switch_us = os_cputime_ticks_to_usecs(ts - sim_switch_ts);
+        }
+    }
+    if (lat < sim_results[sim_phase].lat_min) {
+        sim_results[sim_phase].lat_min = lat;
+    }
+    if (lat > sim_results[sim_phase].lat_max) {
+        sim_results[sim_phase].lat_max = lat;
+    }
+    sim_results[sim_phase].lat_sum += lat;
+    sim_results[sim_phase].last_ts = ts;
+    sim_results[sim_phase].received++;
+
+    if (sim_results[sim_phase].received < sim_results[sim_phase].expected) {
+        if (sim_phase == PHASE_BURST &&
+            sim_results[sim_phase].sent < sim_results[sim_phase].expected) {
+            sim_type();
+        }
+        return;
+    }
+
+    if (sim_phase != PHASE_PRE_LINK || sim_subscribed) {
+        sim_next_phase();
+    }
+}
+
+/* a fake central bonded as the host of 'slot', as if loaded from flash */
+static void
+sim_bond_central(int slot, const char *addr)
+{
+    struct ble_store_value_sec sec;
+    int rc;
+
+    memset(&sec, 0, sizeof(sec));
+    sec.peer_addr.type = BLE_ADDR_PUBLIC;
+    memcpy(sec.peer_addr.val, addr, 6);
+    sec.key_size = 16;
+    sec.ediv = SIM_LTK_EDIV;
+    sec.rand_num = SIM_LTK_RAND;
+    memset(sec.ltk, SIM_LTK_BYTE, sizeof(sec.ltk));
+    sec.ltk_present = 1;
+    rc = ble_store_write_our_sec(&sec);
+    assert(rc == 0);
+
+    rc = hid_bond_seed(slot, BLE_ADDR_PUBLIC, (const uint8_t *)addr);
+    assert(rc == 0);
+}
+
+static void
+sim_task_handler(void *arg)
+{
+    int i;
+
+    /* typed while the host is still starting up, queued until the link */
+    for (i = 0; i < SIM_PRE_LINK_REPORTS; ++i) {
+        sim_type();
+    }
+
+    while (1) {
+        os_eventq_run(&sim_evq);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    int rc;
+
+    /* the key press wakes the board, which finds slot 1 retained */
+    clock_gettime(CLOCK_MONOTONIC, &sim_wake_ts);
+    rc = hid_bond_seed_wake(1, BLE_ADDR_PUBLIC,
+                            (const uint8_t *)SIM_CENTRAL2_ADDR);
+    assert(rc == 0);
+
+    sysinit();
+    sim_bond_central(0, SIM_CENTRAL_ADDR);
+    sim_bond_central(1, SIM_CENTRAL2_ADDR);
+
+    os_eventq_init(&sim_evq);
+    os_callout_init(&sim_step_timer, &sim_evq, sim_step, NULL);
+    os_callout_init(&sim_timeout_timer, &sim_evq, sim_timeout, NULL);
+#if MYNEWT_VAL(BLE_HID_BENCH)
+    sim_bench_init();
+#endif
+    os_callout_reset(&sim_timeout_timer, os_time_ms_to_ticks32(SIM_TIMEOUT_MS));
+
+    /* the controller runs ahead of the host, HCI commands block on it */
+    sim_ctlr_init(&sim_evq);
+    os_task_init(&sim_task, "sim", sim_task_handler, NULL,
+                 MYNEWT_VAL(HID_SIM_TASK_PRIO), OS_WAIT_FOREVER,
+                 sim_stack, MYNEWT_VAL(HID_SIM_TASK_STACK_SIZE));
+
+    while (1) {
+        os_eventq_run(os_eventq_dflt_get());
+    }
+    assert(0);
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_HID_SIM_
+#define H_HID_SIM_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "os/os.h"
+#include "nimble/ble.h"
+
+/*
+   Fake controller on the RAM HCI transport.  It answers the host's HCI
+   commands, "connects" as soon as advertising is enabled and plays a
+   central on the link: starts encryption with the bond's LTK, answers
+   the MTU exchange and connection parameter requests, discovers every
+   attribute, reads the report map, enables every CCCD, switches the
+   protocol mode on request and timestamps every notification.  Directed
+   advertising is answered by the central it is addressed to.
+ */
+
+/* public addresses of the fake centrals, little endian.  The first is
+   the host of slot 0, the second the host of slot 1 that is retained
+   over System OFF and connects at boot */
+#define SIM_CENTRAL_ADDR    "\x01\x00\x00\xc0\xde\xc0"
+#define SIM_CENTRAL2_ADDR   "\x03\x00\x00\xc0\xde\xc0"
+
+/* EDIV and Rand the centrals start encryption with, the LTK of both
+   bonds is SIM_LTK_BYTE repeated */
+#define SIM_LTK_EDIV        0x1234
+#define SIM_LTK_RAND        0x0123456789abcdefULL
+#define SIM_LTK_BYTE        0x5a
+
+void sim_ctlr_init(struct os_eventq *evq);
+
+/*
+   Drops the link with a supervision timeout.  Unless 'answer_directed',
+   the central ignores directed advertising from then on: high duty
+   directed advertising ends on the controller's timeout, low duty on the
+   host's, and the central connects again once the keyboard advertises
+   undirected.
+ */
+void sim_ctlr_link_loss(bool answer_directed);
+
+/* links encrypted with the stored bond so far */
+int sim_ctlr_encrypted(void);
+
+/*
+   us from the connection to the last CCCD written, with the report map
+   length and the number of reads it took
+ */
+uint32_t sim_ctlr_discovery_time(int *map_len, int *map_reads);
+
+/* Write Command to the Protocol Mode characteristic, 0 boot, 1 report */
+int sim_ctlr_set_protocol_mode(uint8_t mode);
+
+/* Callbacks into the script, run in the sim task */
+void sim_on_connected(bool hd_directed, const ble_addr_t *peer);
+void sim_on_subscribed(void);
+void sim_on_notify(uint16_t attr_handle, const uint8_t *data, int len,
+                   uint32_t ts);
+
+#endif
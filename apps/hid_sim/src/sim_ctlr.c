@@ -0,0 +1,775 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "os/mynewt.h"
+#include "os/endian.h"
+#include "nimble/ble.h"
+#include "nimble/ble_hci_trans.h"
+#include "sim.h"
+
+#define SIM_CONN_HANDLE         1
+#define SIM_MTU                 247
+
+/* high duty directed advertising ends a bit before the host's 1.28 s timer */
+#define SIM_HD_DIR_ADV_MS       1200
+
+/* LE Set Advertising Parameters advertising types */
+#define ADV_TYPE_DIRECT_HD      0x01
+#define ADV_TYPE_DIRECT_LD      0x04
+
+#define ERR_CONN_SPVN_TMO       0x08
+#define ERR_DIR_ADV_TMO         0x3c
+
+/* HCI events */
+#define EVT_DISCONN_CMP         0x05
+#define EVT_ENC_CHANGE          0x08
+#define EVT_CMD_CMP             0x0e
+#define EVT_CMD_STATUS          0x0f
+#define EVT_NUM_COMP_PKTS       0x13
+#define EVT_LE_META             0x3e
+
+#define LE_SUBEV_CONN_CMP       0x01
+#define LE_SUBEV_CONN_UPD_CMP   0x03
+#define LE_SUBEV_LTK_REQ        0x05
+#define LE_SUBEV_PHY_UPD_CMP    0x0c
+
+#define OP(ogf, ocf)            (((ogf) << 10) | (ocf))
+
+/* ACL packet boundary flag of a first, flushable fragment */
+#define ACL_PB_FIRST            0x2000
+
+#define L2CAP_CID_ATT           0x0004
+#define L2CAP_CID_SIG           0x0005
+#define L2CAP_SIG_UPD_REQ       0x12
+#define L2CAP_SIG_UPD_RSP       0x13
+
+#define ATT_ERROR_RSP           0x01
+#define ATT_MTU_REQ             0x02
+#define ATT_MTU_RSP             0x03
+#define ATT_FIND_INFO_REQ       0x04
+#define ATT_FIND_INFO_RSP       0x05
+#define ATT_READ_REQ            0x0a
+#define ATT_READ_RSP            0x0b
+#define ATT_READ_BLOB_REQ       0x0c
+#define ATT_READ_BLOB_RSP       0x0d
+#define ATT_WRITE_REQ           0x12
+#define ATT_WRITE_RSP           0x13
+#define ATT_NOTIFY              0x1b
+#define ATT_INDICATE            0x1d
+#define ATT_CONFIRM             0x1e
+#define ATT_WRITE_CMD           0x52
+
+#define UUID_CCCD               0x2902
+#define UUID_PROTO_MODE         0x2a4e
+#define UUID_REPORT_MAP         0x2a4b
+
+#define SIM_MAX_CCCDS           16
+#define SIM_ACL_RING            32
+
+/* Return parameter length (after the status) of the commands the host sends */
+static const struct {
+    uint16_t opcode;
+    uint8_t len;
+} sim_cmd_rsp_len[] = {
+    { OP(0x03, 0x0001), 0 },    /* Set Event Mask */
+    { OP(0x03, 0x0003), 0 },    /* Reset */
+    { OP(0x03, 0x0063), 0 },    /* Set Event Mask Page 2 */
+    { OP(0x04, 0x0001), 8 },    /* Read Local Version */
+    { OP(0x04, 0x0002), 64 },   /* Read Local Supported Commands */
+    { OP(0x04, 0x0003), 8 },    /* Read Local Supported Features */
+    { OP(0x04, 0x0005), 7 },    /* Read Buffer Size */
+    { OP(0x04, 0x0009), 6 },    /* Read BD_ADDR */
+    { OP(0x05, 0x0005), 3 },    /* Read RSSI */
+    { OP(0x05, 0x0008), 3 },    /* Read Encryption Key Size */
+    { OP(0x08, 0x0001), 0 },    /* LE Set Event Mask */
+    { OP(0x08, 0x0002), 3 },    /* LE Read Buffer Size */
+    { OP(0x08, 0x0003), 8 },    /* LE Read Local Supported Features */
+    { OP(0x08, 0x0005), 0 },    /* LE Set Random Address */
+    { OP(0x08, 0x0006), 0 },    /* LE Set Advertising Parameters */
+    { OP(0x08, 0x0007), 1 },    /* LE Read Advertising Channel TX Power */
+    { OP(0x08, 0x0008), 0 },    /* LE Set Advertising Data */
+    { OP(0x08, 0x0009), 0 },    /* LE Set Scan Response Data */
+    { OP(0x08, 0x000a), 0 },    /* LE Set Advertising Enable */
+    { OP(0x08, 0x000f), 1 },    /* LE Read White List Size */
+    { OP(0x08, 0x0017), 16 },   /* LE Encrypt */
+    { OP(0x08, 0x0018), 8 },    /* LE Rand */
+    { OP(0x08, 0x001a), 2 },    /* LE LTK Request Reply */
+    { OP(0x08, 0x001b), 2 },    /* LE LTK Request Negative Reply */
+    { OP(0x08, 0x001c), 8 },    /* LE Read Supported States */
+    { OP(0x08, 0x0020), 2 },    /* LE Remote Conn Param Request Reply */
+    { OP(0x08, 0x0021), 2 },    /* LE Remote Conn Param Request Neg Reply */
+    { OP(0x08, 0x0022), 2 },    /* LE Set Data Length */
+    { OP(0x08, 0x0023), 4 },    /* LE Read Suggested Default Data Length */
+    { OP(0x08, 0x0024), 0 },    /* LE Write Suggested Default Data Length */
+    { OP(0x08, 0x0027), 0 },    /* LE Add Device To Resolving List */
+    { OP(0x08, 0x0028), 0 },    /* LE Remove Device From Resolving List */
+    { OP(0x08, 0x0029), 0 },    /* LE Clear Resolving List */
+    { OP(0x08, 0x002a), 1 },    /* LE Read Resolving List Size */
+    { OP(0x08, 0x002d), 0 },    /* LE Set Address Resolution Enable */
+    { OP(0x08, 0x002e), 0 },    /* LE Set RPA Timeout */
+    { OP(0x08, 0x002f), 8 },    /* LE Read Maximum Data Length */
+    { OP(0x08, 0x0030), 4 },    /* LE Read PHY */
+    { OP(0x08, 0x0031), 0 },    /* LE Set Default PHY */
+    { OP(0x08, 0x004e), 0 },    /* LE Set Privacy Mode */
+};
+
+/* Commands acked with Command Status, the result comes in a later event */
+static const uint16_t sim_cmd_status[] = {
+    OP(0x01, 0x0006),           /* Disconnect */
+    OP(0x08, 0x0013),           /* LE Connection Update */
+    OP(0x08, 0x0016),           /* LE Read Remote Features */
+    OP(0x08, 0x0032),           /* LE Set PHY */
+};
+
+static struct os_eventq *sim_evq;
+
+/* last host command, the host has one outstanding at a time */
+static uint8_t sim_cmd[BLE_HCI_TRANS_CMD_SZ];
+static struct os_event sim_cmd_ev;
+
+/* ACL packets from the host with their arrival time */
+static struct {
+    struct os_mbuf *om;
+    uint32_t ts;
+} sim_acl_ring[SIM_ACL_RING];
+static uint32_t sim_acl_head;
+static uint32_t sim_acl_tail;
+static struct os_event sim_acl_ev;
+
+static struct os_callout sim_conn_timer;
+static struct os_callout sim_dir_adv_timer;
+
+static uint8_t sim_adv_type;
+static ble_addr_t sim_adv_peer;
+/* central of the current or last link */
+static ble_addr_t sim_peer;
+/* after the last link loss the central only answers undirected advertising */
+static bool sim_ignore_directed;
+
+static enum {
+    CENTRAL_IDLE,
+    CENTRAL_DISCOVER,
+    CENTRAL_READ_MAP,
+    CENTRAL_SUBSCRIBE,
+    CENTRAL_READY,
+} sim_central;
+
+static bool sim_connected;
+static int sim_encrypted;
+static uint16_t sim_cccds[SIM_MAX_CCCDS];
+static int sim_num_cccds;
+static int sim_next_cccd;
+static uint16_t sim_proto_mode_handle;
+static uint16_t sim_report_map_handle;
+
+/* discovery as a host does it: all attributes, the report map, the CCCDs */
+static uint32_t sim_conn_ts;
+static uint32_t sim_discovery_us;
+static uint16_t sim_report_map_len;
+static uint8_t sim_report_map_reads;
+
+static void
+sim_evt_send(const uint8_t *ev, int len)
+{
+    uint8_t *buf;
+    int type;
+
+    type = (ev[0] == EVT_CMD_CMP || ev[0] == EVT_CMD_STATUS) ?
+           BLE_HCI_TRANS_BUF_EVT_HI : BLE_HCI_TRANS_BUF_EVT_LO;
+    buf = ble_hci_trans_buf_alloc(type);
+    assert(buf != NULL);
+    memcpy(buf, ev, len);
+    ble_hci_trans_ll_evt_tx(buf);
+}
+
+static void
+sim_le_meta_send(const uint8_t *params, int len)
+{
+    uint8_t ev[2 + 32];
+
+    ev[0] = EVT_LE_META;
+    ev[1] = len;
+    memcpy(ev + 2, params, len);
+    sim_evt_send(ev, 2 + len);
+}
+
+static void
+sim_l2cap_send(uint16_t cid, const uint8_t *data, int len)
+{
+    struct os_mbuf *om;
+    uint8_t hdr[8];
+    int rc;
+
+    om = os_msys_get_pkthdr(sizeof(hdr) + len, sizeof(struct ble_mbuf_hdr));
+    assert(om != NULL);
+
+    put_le16(hdr, SIM_CONN_HANDLE | ACL_PB_FIRST);
+    put_le16(hdr + 2, len + 4);
+    put_le16(hdr + 4, len);
+    put_le16(hdr + 6, cid);
+    rc = os_mbuf_append(om, hdr, sizeof(hdr));
+    rc |= os_mbuf_append(om, data, len);
+    assert(rc == 0);
+
+    ble_hci_trans_ll_acl_tx(om);
+}
+
+/* the central starts encryption with the stored bond */
+static void
+sim_ltk_request(void)
+{
+    uint8_t p[13];
+
+    p[0] = LE_SUBEV_LTK_REQ;
+    put_le16(p + 1, SIM_CONN_HANDLE);
+    put_le64(p + 3, SIM_LTK_RAND);
+    put_le16(p + 11, SIM_LTK_EDIV);
+    sim_le_meta_send(p, sizeof(p));
+}
+
+static void
+sim_conn_complete(struct os_event *ev)
+{
+    uint8_t p[19] = { 0 };
+    bool directed;
+
+    directed = sim_adv_type == ADV_TYPE_DIRECT_HD ||
+               sim_adv_type == ADV_TYPE_DIRECT_LD;
+    if (directed) {
+        sim_peer = sim_adv_peer;
+    }
+
+    p[0] = LE_SUBEV_CONN_CMP;
+    p[1] = 0;                               /* status */
+    put_le16(p + 2, SIM_CONN_HANDLE);
+    p[4] = 1;                               /* we are the peripheral */
+    p[5] = sim_peer.type;
+    memcpy(p + 6, sim_peer.val, 6);
+    put_le16(p + 12, 24);                   /* 30 ms */
+    put_le16(p + 14, 0);
+    put_le16(p + 16, 400);
+    p[18] = 0;
+    sim_le_meta_send(p, sizeof(p));
+
+    sim_connected = true;
+    sim_central = CENTRAL_IDLE;
+    sim_num_cccds = 0;
+    sim_proto_mode_handle = 0;
+    sim_report_map_handle = 0;
+    sim_report_map_len = 0;
+    sim_report_map_reads = 0;
+    sim_conn_ts = os_cputime_get32();
+
+    sim_on_connected(sim_adv_type == ADV_TYPE_DIRECT_HD, &sim_peer);
+    sim_ltk_request();
+}
+
+/* the controller gives up high duty directed advertising */
+static void
+sim_dir_adv_timeout(struct os_event *ev)
+{
+    uint8_t p[19] = { 0 };
+
+    p[0] = LE_SUBEV_CONN_CMP;
+    p[1] = ERR_DIR_ADV_TMO;
+    p[4] = 1;
+    sim_le_meta_send(p, sizeof(p));
+}
+
+static void
+sim_after_cmd(uint16_t opcode, const uint8_t *params)
+{
+    uint8_t p[12];
+    bool directed;
+
+    switch (opcode) {
+    case OP(0x08, 0x0006):
+        sim_adv_type = params[4];
+        sim_adv_peer.type = params[6];
+        memcpy(sim_adv_peer.val, params + 7, 6);
+        break;
+
+    case OP(0x08, 0x001a): {
+        uint8_t ev[6] = { EVT_ENC_CHANGE, 4, 0, 0, 0, 1 };
+
+        put_le16(ev + 3, get_le16(params));
+        sim_evt_send(ev, sizeof(ev));
+        sim_encrypted++;
+        break;
+    }
+
+    case OP(0x08, 0x001b):
+        printf("sim: the host has no LTK for the central\n");
+        break;
+
+    case OP(0x08, 0x000a):
+        if (!params[0]) {
+            os_callout_stop(&sim_conn_timer);
+            os_callout_stop(&sim_dir_adv_timer);
+            break;
+        }
+        if (sim_connected) {
+            break;
+        }
+        directed = sim_adv_type == ADV_TYPE_DIRECT_HD ||
+                   sim_adv_type == ADV_TYPE_DIRECT_LD;
+        if (!directed || !sim_ignore_directed) {
+            /* a central is always in range */
+            os_callout_reset(&sim_conn_timer, os_time_ms_to_ticks32(10));
+        } else if (sim_adv_type == ADV_TYPE_DIRECT_HD) {
+            os_callout_reset(&sim_dir_adv_timer,
+                             os_time_ms_to_ticks32(SIM_HD_DIR_ADV_MS));
+        }
+        break;
+
+    case OP(0x01, 0x0006): {
+        uint8_t ev[6] = { EVT_DISCONN_CMP, 4, 0, 0, 0, 0x16 };
+
+        put_le16(ev + 3, get_le16(params));
+        sim_evt_send(ev, sizeof(ev));
+        sim_connected = false;
+        break;
+    }
+
+    case OP(0x08, 0x0013):
+        p[0] = LE_SUBEV_CONN_UPD_CMP;
+        p[1] = 0;
+        memcpy(p + 2, params, 2);           /* handle */
+        memcpy(p + 4, params + 4, 2);       /* interval max */
+        memcpy(p + 6, params + 6, 4);       /* latency, timeout */
+        sim_le_meta_send(p, 10);
+        break;
+
+    case OP(0x08, 0x0032):
+        p[0] = LE_SUBEV_PHY_UPD_CMP;
+        p[1] = 0;
+        memcpy(p + 2, params, 2);
+        /* the central takes the fastest PHY offered */
+        p[4] = (params[3] & 0x02) ? 2 : (params[3] & 0x04) ? 3 : 1;
+        p[5] = p[4];
+        sim_le_meta_send(p, 6);
+        break;
+    }
+}
+
+static void
+sim_cmd_handle(struct os_event *ev)
+{
+    uint8_t rsp[6 + 64];
+    uint16_t opcode;
+    int len = -1;
+    int i;
+
+    opcode = get_le16(sim_cmd);
+
+    for (i = 0; i < sizeof(sim_cmd_status) / sizeof(sim_cmd_status[0]); ++i) {
+        if (sim_cmd_status[i] == opcode) {
+            rsp[0] = EVT_CMD_STATUS;
+            rsp[1] = 4;
+            rsp[2] = 0;
+            rsp[3] = 1;
+            put_le16(rsp + 4, opcode);
+            sim_evt_send(rsp, 6);
+            sim_after_cmd(opcode, sim_cmd + 3);
+            return;
+        }
+    }
+
+    for (i = 0; i < sizeof(sim_cmd_rsp_len) / sizeof(sim_cmd_rsp_len[0]); ++i) {
+        if (sim_cmd_rsp_len[i].opcode == opcode) {
+            len = sim_cmd_rsp_len[i].len;
+            break;
+        }
+    }
+
+    memset(rsp, 0, sizeof(rsp));
+    rsp[0] = EVT_CMD_CMP;
+    rsp[2] = 1;
+    put_le16(rsp + 3, opcode);
+
+    if (len < 0) {
+        printf("sim: unknown HCI command %04x\n", opcode);
+        rsp[5] = 0x01;                      /* Unknown HCI Command */
+        len = 0;
+    }
+
+    switch (opcode) {
+    case OP(0x04, 0x0001):
+        rsp[6] = 0x09;                      /* HCI 5.0 */
+        rsp[9] = 0x09;
+        put_le16(rsp + 10, 0xffff);
+        break;
+    case OP(0x04, 0x0002):
+        memset(rsp + 6, 0xff, 64);
+        break;
+    case OP(0x04, 0x0009):
+        memcpy(rsp + 6, "\x02\x00\x00\xc0\xde\xc0", 6);
+        break;
+    case OP(0x05, 0x0005):
+        memcpy(rsp + 6, sim_cmd + 3, 2);
+        rsp[8] = (uint8_t)-50;
+        break;
+    case OP(0x05, 0x0008):
+        memcpy(rsp + 6, sim_cmd + 3, 2);
+        rsp[8] = 16;
+        break;
+    case OP(0x08, 0x0002):
+        put_le16(rsp + 6, 251);
+        rsp[8] = 8;
+        break;
+    case OP(0x08, 0x0018):
+        for (i = 0; i < 8; ++i) {
+            rsp[6 + i] = rand();
+        }
+        break;
+    case OP(0x08, 0x002f):
+        put_le16(rsp + 6, 251);
+        put_le16(rsp + 8, 2120);
+        put_le16(rsp + 10, 251);
+        put_le16(rsp + 12, 2120);
+        break;
+    default:
+        if (len == 2 || len == 4) {
+            /* connection handle first */
+            memcpy(rsp + 6, sim_cmd + 3, 2);
+        }
+        break;
+    }
+
+    rsp[1] = 4 + len;
+    sim_evt_send(rsp, 6 + len);
+    sim_after_cmd(opcode, sim_cmd + 3);
+}
+
+static int
+sim_rx_cmd(uint8_t *cmd, void *arg)
+{
+    memcpy(sim_cmd, cmd, 3 + cmd[2]);
+    ble_hci_trans_buf_free(cmd);
+    os_eventq_put(sim_evq, &sim_cmd_ev);
+    return 0;
+}
+
+static int
+sim_rx_acl(struct os_mbuf *om, void *arg)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    assert(sim_acl_head - sim_acl_tail < SIM_ACL_RING);
+    sim_acl_ring[sim_acl_head % SIM_ACL_RING].om = om;
+    sim_acl_ring[sim_acl_head % SIM_ACL_RING].ts = os_cputime_get32();
+    sim_acl_head++;
+    OS_EXIT_CRITICAL(sr);
+
+    os_eventq_put(sim_evq, &sim_acl_ev);
+    return 0;
+}
+
+static void
+sim_att_send(const uint8_t *pdu, int len)
+{
+    sim_l2cap_send(L2CAP_CID_ATT, pdu, len);
+}
+
+static void
+sim_find_info(uint16_t start)
+{
+    uint8_t req[5] = { ATT_FIND_INFO_REQ };
+
+    put_le16(req + 1, start);
+    put_le16(req + 3, 0xffff);
+    sim_att_send(req, sizeof(req));
+}
+
+static void
+sim_subscribe_next(void)
+{
+    uint8_t req[5] = { ATT_WRITE_REQ };
+
+    if (sim_next_cccd >= sim_num_cccds) {
+        sim_central = CENTRAL_READY;
+        if (sim_discovery_us == 0) {
+            /* the first connection, reconnects are not measured */
+            sim_discovery_us = os_cputime_ticks_to_usecs(os_cputime_get32() -
+                                                         sim_conn_ts);
+        }
+        sim_on_subscribed();
+        return;
+    }
+
+    put_le16(req + 1, sim_cccds[sim_next_cccd++]);
+    put_le16(req + 3, 0x0001);              /* notifications */
+    sim_att_send(req, sizeof(req));
+}
+
+/* Read, then Read Blob while the responses come back full */
+static void
+sim_read_map(void)
+{
+    uint8_t req[5];
+
+    if (sim_report_map_len == 0) {
+        req[0] = ATT_READ_REQ;
+        put_le16(req + 1, sim_report_map_handle);
+        sim_att_send(req, 3);
+    } else {
+        req[0] = ATT_READ_BLOB_REQ;
+        put_le16(req + 1, sim_report_map_handle);
+        put_le16(req + 3, sim_report_map_len);
+        sim_att_send(req, 5);
+    }
+}
+
+static void
+sim_discovery_done(void)
+{
+    if (sim_central == CENTRAL_DISCOVER && sim_report_map_handle) {
+        sim_central = CENTRAL_READ_MAP;
+        sim_read_map();
+        return;
+    }
+
+    sim_central = CENTRAL_SUBSCRIBE;
+    sim_next_cccd = 0;
+    sim_subscribe_next();
+}
+
+static void
+sim_att_rx(const uint8_t *pdu, int len, uint32_t ts)
+{
+    uint8_t rsp[3];
+    uint16_t handle = 0;
+    int i;
+
+    switch (pdu[0]) {
+    case ATT_MTU_REQ:
+        rsp[0] = ATT_MTU_RSP;
+        put_le16(rsp + 1, SIM_MTU);
+        sim_att_send(rsp, 3);
+        if (sim_central == CENTRAL_IDLE) {
+            /* discovery starts once the MTU is settled */
+            sim_central = CENTRAL_DISCOVER;
+            sim_find_info(1);
+        }
+        break;
+
+    case ATT_FIND_INFO_RSP:
+        if (pdu[1] != 0x01) {
+            /* 128 bit UUIDs, nothing we look for */
+            handle = get_le16(pdu + len - 18);
+        }
+        for (i = 2; pdu[1] == 0x01 && i + 4 <= len; i += 4) {
+            handle = get_le16(pdu + i);
+            switch (get_le16(pdu + i + 2)) {
+            case UUID_CCCD:
+                if (sim_num_cccds < SIM_MAX_CCCDS) {
+                    sim_cccds[sim_num_cccds++] = handle;
+                }
+                break;
+            case UUID_PROTO_MODE:
+                /* characteristic value follows the declaration */
+                sim_proto_mode_handle = handle;
+                break;
+            case UUID_REPORT_MAP:
+                sim_report_map_handle = handle;
+                break;
+            }
+        }
+        if (handle == 0xffff) {
+            sim_discovery_done();
+        } else {
+            sim_find_info(handle + 1);
+        }
+        break;
+
+    case ATT_ERROR_RSP:
+        if ((sim_central == CENTRAL_DISCOVER && pdu[1] == ATT_FIND_INFO_REQ) ||
+            (sim_central == CENTRAL_READ_MAP && pdu[1] == ATT_READ_BLOB_REQ)) {
+            /* attribute not found or offset at the end, step done */
+            sim_discovery_done();
+        } else {
+            printf("sim: ATT error %02x on request %02x\n", pdu[4], pdu[1]);
+        }
+        break;
+
+    case ATT_READ_RSP:
+    case ATT_READ_BLOB_RSP:
+        if (sim_central != CENTRAL_READ_MAP) {
+            break;
+        }
+        sim_report_map_len += len - 1;
+        sim_report_map_reads++;
+        if (len - 1 == SIM_MTU - 1) {
+            /* the value may go on */
+            sim_read_map();
+        } else {
+            sim_discovery_done();
+        }
+        break;
+
+    case ATT_WRITE_RSP:
+        if (sim_central == CENTRAL_SUBSCRIBE) {
+            sim_subscribe_next();
+        }
+        break;
+
+    case ATT_INDICATE:
+        rsp[0] = ATT_CONFIRM;
+        sim_att_send(rsp, 1);
+        /* fall through */
+    case ATT_NOTIFY:
+        sim_on_notify(get_le16(pdu + 1), pdu + 3, len - 3, ts);
+        break;
+    }
+}
+
+static void
+sim_sig_rx(const uint8_t *pdu, int len)
+{
+    uint8_t rsp[6];
+    uint8_t p[10];
+
+    if (pdu[0] != L2CAP_SIG_UPD_REQ || len < 12) {
+        return;
+    }
+
+    rsp[0] = L2CAP_SIG_UPD_RSP;
+    rsp[1] = pdu[1];
+    put_le16(rsp + 2, 2);
+    put_le16(rsp + 4, 0);                   /* accepted */
+    sim_l2cap_send(L2CAP_CID_SIG, rsp, sizeof(rsp));
+
+    p[0] = LE_SUBEV_CONN_UPD_CMP;
+    p[1] = 0;
+    put_le16(p + 2, SIM_CONN_HANDLE);
+    memcpy(p + 4, pdu + 6, 2);              /* interval max */
+    memcpy(p + 6, pdu + 8, 4);              /* latency, timeout */
+    sim_le_meta_send(p, sizeof(p));
+}
+
+static void
+sim_acl_handle(struct os_event *ev)
+{
+    uint8_t nocp[7] = { EVT_NUM_COMP_PKTS, 5, 1 };
+    uint8_t buf[4 + 4 + SIM_MTU];
+    struct os_mbuf *om;
+    uint32_t ts;
+    int len;
+    os_sr_t sr;
+
+    while (1) {
+        OS_ENTER_CRITICAL(sr);
+        if (sim_acl_tail == sim_acl_head) {
+            OS_EXIT_CRITICAL(sr);
+            break;
+        }
+        om = sim_acl_ring[sim_acl_tail % SIM_ACL_RING].om;
+        ts = sim_acl_ring[sim_acl_tail % SIM_ACL_RING].ts;
+        sim_acl_tail++;
+        OS_EXIT_CRITICAL(sr);
+
+        len = OS_MBUF_PKTLEN(om);
+        if (len > sizeof(buf)) {
+            len = sizeof(buf);
+        }
+        os_mbuf_copydata(om, 0, len, buf);
+        os_mbuf_free_chain(om);
+
+        /* the packet is "on air", hand the buffer back to the host */
+        put_le16(nocp + 3, SIM_CONN_HANDLE);
+        put_le16(nocp + 5, 1);
+        sim_evt_send(nocp, sizeof(nocp));
+
+        if (len < 8) {
+            continue;
+        }
+        switch (get_le16(buf + 6)) {
+        case L2CAP_CID_ATT:
+            sim_att_rx(buf + 8, len - 8, ts);
+            break;
+        case L2CAP_CID_SIG:
+            sim_sig_rx(buf + 8, len - 8);
+            break;
+        }
+    }
+}
+
+int
+sim_ctlr_encrypted(void)
+{
+    return sim_encrypted;
+}
+
+uint32_t
+sim_ctlr_discovery_time(int *map_len, int *map_reads)
+{
+    *map_len = sim_report_map_len;
+    *map_reads = sim_report_map_reads;
+    return sim_discovery_us;
+}
+
+void
+sim_ctlr_link_loss(bool answer_directed)
+{
+    uint8_t ev[6] = { EVT_DISCONN_CMP, 4, 0, 0, 0, ERR_CONN_SPVN_TMO };
+
+    if (!sim_connected) {
+        return;
+    }
+
+    put_le16(ev + 3, SIM_CONN_HANDLE);
+    sim_evt_send(ev, sizeof(ev));
+    sim_connected = false;
+    sim_central = CENTRAL_IDLE;
+    sim_ignore_directed = !answer_directed;
+}
+
+int
+sim_ctlr_set_protocol_mode(uint8_t mode)
+{
+    uint8_t req[4] = { ATT_WRITE_CMD };
+
+    if (sim_central != CENTRAL_READY || sim_proto_mode_handle == 0) {
+        return SYS_EAGAIN;
+    }
+
+    put_le16(req + 1, sim_proto_mode_handle);
+    req[3] = mode;
+    sim_att_send(req, sizeof(req));
+    return 0;
+}
+
+void
+sim_ctlr_init(struct os_eventq *evq)
+{
+    sim_evq = evq;
+    sim_peer.type = BLE_ADDR_PUBLIC;
+    memcpy(sim_peer.val, SIM_CENTRAL_ADDR, 6);
+    sim_cmd_ev.ev_cb = sim_cmd_handle;
+    sim_acl_ev.ev_cb = sim_acl_handle;
+    os_callout_init(&sim_conn_timer, evq, sim_conn_complete, NULL);
+    os_callout_init(&sim_dir_adv_timer, evq, sim_dir_adv_timeout, NULL);
+
+    ble_hci_trans_cfg_ll(sim_rx_cmd, NULL, sim_rx_acl, NULL);
+}
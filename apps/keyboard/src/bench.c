@@ -0,0 +1,66 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "os/mynewt.h"
+#include "nimble-hid/hid_bench.h"
+#include "nimble-hid/nimble-hid.h"
+#include "keycode.h"
+#include "keymap.h"
+#include "matrix.h"
+#include "bench.h"
+
+#if MYNEWT_VAL(BLE_HID_BENCH)
+/*
+   Key state to report the way tmk does it: keymap lookup of every
+   pressed switch and the 8 byte report handed to nimble-hid.  The
+   matrix is synthetic, one switch down per iteration walking the whole
+   board; scanning the real one here would race the tmk task.
+ */
+static void
+bench_matrix_report(uint32_t i, void *arg)
+{
+    uint8_t report[8] = { 0 };
+    keypos_t key;
+    action_t action;
+    uint8_t code;
+
+    key.row = i % MATRIX_ROWS;
+    key.col = (i / MATRIX_ROWS) % MATRIX_COLS;
+
+    action = action_for_key(0, key);
+    code = action.key.code;
+    if (IS_MOD(code)) {
+        report[0] |= MOD_BIT(code);
+    } else if (code != KC_NO) {
+        report[2] = code;
+    }
+
+    hid_send_keyboard_report(report, sizeof(report));
+}
+
+static struct hid_bench_op bench_matrix_op = {
+    .name = "matrix_to_report",
+    .fn = bench_matrix_report,
+};
+
+void
+bench_init(void)
+{
+    hid_bench_op_register(&bench_matrix_op);
+}
+#endif
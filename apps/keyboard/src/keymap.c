@@ -1,6 +1,11 @@
 #include "os/mynewt.h"
 #include "matrix.h"
 #include "keycode.h"
+#include "nimble-hid/hid_prof.h"
+
+#if MYNEWT_VAL(BLE_HID_PROF)
+#include "action.h"
+#endif
 
 #define _BASE 0
 
@@ -52,3 +57,16 @@ KC_TAB,  KC_Q,   KC_W,   KC_E,   KC_R,   KC_T,   KC_Y,   KC_U,   KC_I,   KC_O,
 KC_CAPS, KC_A,   KC_S,   KC_D,   KC_F,   KC_G,   KC_H,   KC_J,   KC_K,   KC_L,KC_SCLN,KC_QUOT,         KC_ENT,                            KC_P4,  KC_P5,  KC_P6,      \
 KC_LSFT, KC_Z,   KC_X,   KC_C,   KC_V,   KC_B,   KC_N,   KC_M,   KC_COMM,KC_DOT,      KC_SLSH,        KC_RSFT,            KC_UP,          KC_P1,  KC_P2,  KC_P3,KC_PENT, \
 KC_LCTL,KC_LGUI, KC_LALT,                 KC_SPC,                                KC_RALT,KC_RGUI, KC_APP,KC_RCTL, KC_LEFT,KC_DOWN,KC_RGHT, KC_P0,KC_PDOT)};
+
+#if MYNEWT_VAL(BLE_HID_PROF)
+/* tmk's lookup, reached through -Wl,--wrap=action_for_key (pkg.yml) */
+action_t __real_action_for_key(uint8_t layer, keypos_t key);
+
+action_t
+__wrap_action_for_key(uint8_t layer, keypos_t key)
+{
+    HID_PROF_SCOPE(HID_PROF_KEYMAP);
+
+    return __real_action_for_key(layer, key);
+}
+#endif
@@ -20,6 +20,8 @@
 #include "sysinit/sysinit.h"
 #include "os/os.h"
 #include "hal/hal_watchdog.h"
+#include "bench.h"
+#include "mem.h"
 
 /**
  * main
@@ -34,9 +36,16 @@ main(int argc, char **argv)
 {
     sysinit();
 
-    /* TODO: Without this sleep, the usb cannot be initialized correctly. Could be a shorter delay */
-    os_time_delay(OS_TICKS_PER_SEC);
+#if MYNEWT_VAL(SHELL_TASK)
+    mem_init();
+#endif
+#if MYNEWT_VAL(BLE_HID_BENCH)
+    bench_init();
+#endif
 
+    /* USB comes up in the tinyusb task, see usb.c; scanning and BLE do
+     * not wait for it.
+     */
     while (1) {
         os_eventq_run(os_eventq_dflt_get());
         hal_watchdog_tickle();
@@ -1,7 +1,21 @@
+#include <assert.h>
+#include <string.h>
 #include "hal/hal_gpio.h"
 #include "os/os.h"
+#include "stats/stats.h"
+#if MYNEWT_VAL(SHELL_TASK)
+#include "console/console.h"
+#include "shell/shell.h"
+#endif
+#include "nimble-hid/nimble-hid.h"
+#include "nimble-hid/hid_anchor.h"
+#include "nimble-hid/hid_prof.h"
+#include "nimble-hid/hid_trace.h"
 
 #include "matrix.h"
+#if MYNEWT_VAL(KB_SLEEP_MS) > 0
+#include "sleep.h"
+#endif
 
 #if (MATRIX_COLS <= 8)
 #    define print_matrix_header()  print("\nr/c 01234567\n")
@@ -20,17 +34,340 @@
 #    define ROW_SHIFTER  ((uint32_t)1)
 #endif
 
+/*
+   Debounce window in ms.  The first change of a row is passed on at once,
+   further changes of that row within the window are bounces and held back
+   until it ends.
+ */
+#ifndef DEBOUNCE
+#define DEBOUNCE 5
+#endif
+
+STATS_SECT_START(kb_matrix_stats)
+    STATS_SECT_ENTRY(scans)
+    STATS_SECT_ENTRY(edges)
+    STATS_SECT_ENTRY(bounces)
+    STATS_SECT_ENTRY(irq_sleeps)
+    STATS_SECT_ENTRY(irq_wakes)
+    STATS_SECT_ENTRY(irq_polled)
+    STATS_SECT_ENTRY(wake_keys)
+STATS_SECT_END
+
+STATS_NAME_START(kb_matrix_stats)
+    STATS_NAME(kb_matrix_stats, scans)
+    STATS_NAME(kb_matrix_stats, edges)
+    STATS_NAME(kb_matrix_stats, bounces)
+    STATS_NAME(kb_matrix_stats, irq_sleeps)
+    STATS_NAME(kb_matrix_stats, irq_wakes)
+    STATS_NAME(kb_matrix_stats, irq_polled)
+    STATS_NAME(kb_matrix_stats, wake_keys)
+STATS_NAME_END(kb_matrix_stats)
+
+static STATS_SECT_DECL(kb_matrix_stats) kb_matrix_stats;
+
 static const int row_pins[MATRIX_ROWS] = MYNEWT_VAL(TMK_MATRIX_ROW_PINS);
 static const int col_pins[MATRIX_COLS] = MYNEWT_VAL(TMK_MATRIX_COL_PINS);
+/* raw state from the last scan */
 static matrix_row_t matrix[MATRIX_ROWS];
+/* debounced state, what tmk sees */
+static matrix_row_t matrix_debounced[MATRIX_ROWS];
+/* cputime of the last accepted change of every row */
+static uint32_t row_edge_ts[MATRIX_ROWS];
+
+#if MYNEWT_VAL(KB_SLEEP_MS) > 0
+/*
+   Keys down at the first scan after a System OFF wake.  They stay in the
+   matrix tmk sees for two debounce windows, so a tap shorter than the
+   boot still makes a press and a release report.
+ */
+static matrix_row_t wake_keys[MATRIX_ROWS];
+static uint32_t wake_keys_ts;
+static bool wake_keys_held;
+#endif
+
+/* released by the scan timer or a column interrupt */
+static struct hal_timer scan_timer;
+static struct os_sem scan_sem;
+
+/*
+   Scan rate governor.  Full rate (KB_SCAN_FAST_US) while a key is down
+   and for KB_SCAN_ACTIVE_MS after, then the period doubles every
+   KB_SCAN_DECAY_MS up to KB_SCAN_SLOW_US.  After KB_SCAN_IRQ_MS without
+   activity all rows are driven and the scan waits for a column edge.
+ */
+static struct {
+    /* os_time of the last scan with a key down */
+    os_time_t last_active;
+    /* cputime the last scan started */
+    uint32_t last_scan;
+    uint32_t period_us;
+    /* cputime spent scanning, for the duty cycle */
+    uint32_t busy;
+    uint32_t scans;
+    uint32_t since;
+} scan_gov;
 
 static bool read_cols_on_row(matrix_row_t current_matrix[], uint8_t current_row);
 static void unselect_row(int row);
 static void select_row(int row);
 
+static void
+scan_timer_cb(void *arg)
+{
+    os_sem_release(&scan_sem);
+}
+
+static void
+scan_sleep_until(uint32_t when)
+{
+    os_cputime_timer_start(&scan_timer, when);
+    os_sem_pend(&scan_sem, OS_TIMEOUT_NEVER);
+}
+
+#if MYNEWT_VAL(BLE_HID_ANCHOR_ALIGN_SCAN)
+/* Sleep until the scan slot right before the next connection event */
+static bool
+wait_scan_slot(void)
+{
+    uint32_t release;
+
+    if (hid_anchor_next_release(os_cputime_get32(), &release) != 0) {
+        /* not connected, scan at the governor's rate */
+        return false;
+    }
+
+    scan_sleep_until(release);
+    return true;
+}
+#endif
+
+#if MYNEWT_VAL(KB_SCAN_IRQ_MS) > 0
+static void
+scan_col_irq(void *arg)
+{
+    os_sem_release(&scan_sem);
+}
+
+/* All rows selected, any key pulls its column low.  Gives up after
+ * 'timeout' ticks without a key.  Columns the HAL has no interrupt for
+ * (nRF52: 8 GPIOTE channels without MCU_GPIO_USE_PORT_EVENT) are read
+ * every KB_SCAN_SLOW_US instead. */
+static void
+scan_irq_wait(os_time_t timeout)
+{
+    matrix_row_t polled = 0;
+    os_time_t start = os_time_get();
+    os_time_t wait = timeout;
+    bool down = false;
+    int rc;
+    int x;
+
+    STATS_INC(kb_matrix_stats, irq_sleeps);
+
+    for (x = 0; x < MATRIX_ROWS; x++) {
+        select_row(x);
+    }
+    for (x = 0; x < MATRIX_COLS; x++) {
+        rc = hal_gpio_irq_init(col_pins[x], scan_col_irq, NULL,
+                               HAL_GPIO_TRIG_FALLING, HAL_GPIO_PULL_UP);
+        if (rc != 0) {
+            polled |= (matrix_row_t)1 << x;
+            continue;
+        }
+        hal_gpio_irq_enable(col_pins[x]);
+    }
+    if (polled) {
+        STATS_INC(kb_matrix_stats, irq_polled);
+        wait = os_time_ms_to_ticks32(MYNEWT_VAL(KB_SCAN_SLOW_US) / 1000);
+        if (wait == 0) {
+            wait = 1;
+        }
+        if (wait > timeout) {
+            wait = timeout;
+        }
+    }
+    /* a key pressed before the interrupts were armed */
+    for (x = 0; x < MATRIX_COLS; x++) {
+        down |= !hal_gpio_read(col_pins[x]);
+    }
+
+    while (!down) {
+        if (os_sem_pend(&scan_sem, wait) == OS_OK) {
+            STATS_INC(kb_matrix_stats, irq_wakes);
+            down = true;
+            break;
+        }
+        if (!polled) {
+            break;
+        }
+        for (x = 0; x < MATRIX_COLS; x++) {
+            if (polled & ((matrix_row_t)1 << x)) {
+                down |= !hal_gpio_read(col_pins[x]);
+            }
+        }
+        if (timeout != OS_TIMEOUT_NEVER && os_time_get() - start >= timeout) {
+            break;
+        }
+    }
+
+    for (x = 0; x < MATRIX_COLS; x++) {
+        hal_gpio_irq_release(col_pins[x]);
+        hal_gpio_init_in(col_pins[x], HAL_GPIO_PULL_UP);
+    }
+    for (x = 0; x < MATRIX_ROWS; x++) {
+        unselect_row(x);
+    }
+    /* bounces released the semaphore more than once */
+    while (os_sem_pend(&scan_sem, 0) == OS_OK) {
+    }
+
+    if (down) {
+        scan_gov.last_active = os_time_get();
+    }
+    scan_gov.last_scan = os_cputime_get32();
+}
+#endif
+
+#if MYNEWT_VAL(KB_SLEEP_MS) > 0
+/* Rows driven, the columns wake the chip from System OFF */
+static void
+matrix_sleep(void)
+{
+    int x;
+
+    for (x = 0; x < MATRIX_ROWS; x++) {
+        select_row(x);
+    }
+    sleep_enter(col_pins, MATRIX_COLS);
+}
+
+static void
+matrix_wake_capture(void)
+{
+    int x;
+
+    for (x = 0; x < MATRIX_ROWS; x++) {
+        unselect_row(x);
+    }
+    for (x = 0; x < MATRIX_ROWS; x++) {
+        if (read_cols_on_row(wake_keys, x)) {
+            wake_keys_held = true;
+            STATS_INC(kb_matrix_stats, wake_keys);
+        }
+    }
+    wake_keys_ts = os_cputime_get32();
+}
+#endif
+
+static void
+scan_governor_wait(void)
+{
+    uint32_t idle_ms;
+    uint32_t period;
+#if MYNEWT_VAL(KB_SCAN_IRQ_MS) > 0
+    os_time_t sleep_in = OS_TIMEOUT_NEVER;
+#endif
+    int steps;
+
+    idle_ms = os_time_ticks_to_ms32(os_time_get() - scan_gov.last_active);
+
+#if MYNEWT_VAL(KB_SLEEP_MS) > 0
+    if (idle_ms >= MYNEWT_VAL(KB_SLEEP_MS)) {
+        matrix_sleep();
+    }
+#if MYNEWT_VAL(KB_SCAN_IRQ_MS) > 0
+    /* the column interrupt wait ends in time to go to sleep */
+    sleep_in = os_time_ms_to_ticks32(MYNEWT_VAL(KB_SLEEP_MS) - idle_ms);
+#endif
+#endif
+
+    /* host suspended: once the last key has settled there is nothing to
+     * wait for but the remote wake, skip the decay */
+    if (ble_hid_suspended() && idle_ms >= 2 * DEBOUNCE) {
+        idle_ms = MYNEWT_VAL(KB_SCAN_IRQ_MS) > 0 ?
+                  MYNEWT_VAL(KB_SCAN_IRQ_MS) : UINT32_MAX;
+    }
+
+#if MYNEWT_VAL(KB_SCAN_IRQ_MS) > 0
+    if (idle_ms >= MYNEWT_VAL(KB_SCAN_IRQ_MS)) {
+        scan_gov.period_us = 0;
+        scan_irq_wait(sleep_in);
+        return;
+    }
+#endif
+
+    period = MYNEWT_VAL(KB_SCAN_FAST_US);
+    if (idle_ms >= MYNEWT_VAL(KB_SCAN_ACTIVE_MS)) {
+        steps = (idle_ms - MYNEWT_VAL(KB_SCAN_ACTIVE_MS)) /
+                MYNEWT_VAL(KB_SCAN_DECAY_MS) + 1;
+        while (steps-- > 0 && period < MYNEWT_VAL(KB_SCAN_SLOW_US)) {
+            period *= 2;
+        }
+        if (period > MYNEWT_VAL(KB_SCAN_SLOW_US)) {
+            period = MYNEWT_VAL(KB_SCAN_SLOW_US);
+        }
+    }
+    scan_gov.period_us = period;
+
+#if MYNEWT_VAL(BLE_HID_ANCHOR_ALIGN_SCAN)
+    if (period == MYNEWT_VAL(KB_SCAN_FAST_US) && wait_scan_slot()) {
+        scan_gov.last_scan = os_cputime_get32();
+        return;
+    }
+#endif
+
+    scan_sleep_until(scan_gov.last_scan + os_cputime_usecs_to_ticks(period));
+    scan_gov.last_scan = os_cputime_get32();
+}
+
+#if MYNEWT_VAL(SHELL_TASK)
+/* "scan": governor state, scans/s and scan duty cycle since the last call */
+static int
+scan_cli_cmd(int argc, char **argv)
+{
+    uint32_t now = os_cputime_get32();
+    uint32_t usecs;
+    uint32_t busy;
+
+    usecs = os_cputime_ticks_to_usecs(now - scan_gov.since);
+    busy = os_cputime_ticks_to_usecs(scan_gov.busy);
+    if (usecs == 0) {
+        return 0;
+    }
+
+    if (scan_gov.period_us) {
+        console_printf("period %lu us", (unsigned long)scan_gov.period_us);
+    } else {
+        console_printf("waiting for a key");
+    }
+    /* the scan itself is the power cost, duty is its share of the time */
+    console_printf(", %lu scans/s, duty %lu ppm\n",
+                   (unsigned long)((uint64_t)scan_gov.scans * 1000000 / usecs),
+                   (unsigned long)((uint64_t)busy * 1000000 / usecs));
+
+    scan_gov.since = now;
+    scan_gov.scans = 0;
+    scan_gov.busy = 0;
+    return 0;
+}
+
+static struct shell_cmd scan_cli = {
+    .sc_cmd = "scan",
+    .sc_cmd_func = scan_cli_cmd,
+};
+#endif
+
 void
 matrix_init(void)
 {
+    int rc;
+
+    rc = stats_init_and_reg(STATS_HDR(kb_matrix_stats),
+                            STATS_SIZE_INIT_PARMS(kb_matrix_stats, STATS_SIZE_32),
+                            STATS_NAME_INIT_PARMS(kb_matrix_stats),
+                            "kb_matrix");
+    assert(rc == 0);
+
     for (int x = 0; x < MATRIX_ROWS; x++) {
         int pin = row_pins[x];
         hal_gpio_init_out(pin, 0);
@@ -40,6 +377,23 @@ matrix_init(void)
         int pin = col_pins[x];
         hal_gpio_init_in(pin, HAL_GPIO_PULL_UP);
     }
+
+    os_sem_init(&scan_sem, 0);
+    os_cputime_timer_init(&scan_timer, scan_timer_cb, NULL);
+    scan_gov.last_active = os_time_get();
+    scan_gov.last_scan = scan_gov.since = os_cputime_get32();
+
+#if MYNEWT_VAL(KB_SLEEP_MS) > 0
+    /* before anything else, the key that woke the board may be a tap */
+    if (sleep_woke()) {
+        matrix_wake_capture();
+    }
+#endif
+
+#if MYNEWT_VAL(SHELL_TASK)
+    rc = shell_cmd_register(&scan_cli);
+    assert(rc == 0);
+#endif
 }
 
 static void
@@ -59,6 +413,8 @@ unselect_row(int row)
 static bool
 read_cols_on_row(matrix_row_t current_matrix[], uint8_t current_row)
 {
+    HID_PROF_SCOPE(HID_PROF_READ_COLS);
+
     /* Store last value of row prior to reading */
     matrix_row_t last_row_value = current_matrix[current_row];
 
@@ -86,13 +442,70 @@ read_cols_on_row(matrix_row_t current_matrix[], uint8_t current_row)
     return (last_row_value != current_matrix[current_row]);
 }
 
+/* The raw row differs from the debounced one: pass it on or hold it back */
+static void
+matrix_debounce(int row, bool edge)
+{
+    uint32_t now = os_cputime_get32();
+    matrix_row_t changed = matrix[row] ^ matrix_debounced[row];
+
+    if (now - row_edge_ts[row] < os_cputime_usecs_to_ticks(DEBOUNCE * 1000)) {
+        if (edge) {
+            STATS_INC(kb_matrix_stats, bounces);
+            HID_TRACE(HID_TRACE_DEBOUNCE, row, 1, changed);
+        }
+        return;
+    }
+
+    matrix_debounced[row] = matrix[row];
+    row_edge_ts[row] = now;
+    HID_TRACE(HID_TRACE_DEBOUNCE, row, 0, changed);
+}
+
 uint8_t
 matrix_scan(void)
 {
+    bool active = false;
+
+    scan_governor_wait();
+
+    HID_PROF_SCOPE(HID_PROF_MATRIX_SCAN);
+
+    STATS_INC(kb_matrix_stats, scans);
+
     /* Set row, read cols */
     for (int current_row = 0; current_row < MATRIX_ROWS; current_row++) {
-        read_cols_on_row(matrix, current_row);
+        matrix_row_t last_row_value = matrix[current_row];
+
+        bool edge = read_cols_on_row(matrix, current_row);
+
+        if (edge) {
+            STATS_INC(kb_matrix_stats, edges);
+            HID_TRACE(HID_TRACE_MATRIX_EDGE, current_row, 0,
+                      last_row_value ^ matrix[current_row]);
+        }
+        if (matrix[current_row] != matrix_debounced[current_row]) {
+            matrix_debounce(current_row, edge);
+        }
+        /* a release counts too, and a change still held back */
+        active |= matrix[current_row] || last_row_value ||
+                  matrix_debounced[current_row];
+    }
+
+#if MYNEWT_VAL(KB_SLEEP_MS) > 0
+    if (wake_keys_held && os_cputime_get32() - wake_keys_ts >=
+                          os_cputime_usecs_to_ticks(2 * DEBOUNCE * 1000)) {
+        memset(wake_keys, 0, sizeof(wake_keys));
+        wake_keys_held = false;
     }
+    active |= wake_keys_held;
+#endif
+
+    if (active) {
+        scan_gov.last_active = os_time_get();
+    }
+    scan_gov.scans++;
+    scan_gov.busy += os_cputime_get32() - scan_gov.last_scan;
     return 0;
 }
 
@@ -101,5 +514,9 @@ matrix_get_row(uint8_t row)
 {
     // Matrix mask lets you disable switches in the returned matrix data. For example, if you have a
     // switch blocker installed and the switch is always pressed.
-    return matrix[row];
+#if MYNEWT_VAL(KB_SLEEP_MS) > 0
+    return matrix_debounced[row] | wake_keys[row];
+#else
+    return matrix_debounced[row];
+#endif
 }
@@ -0,0 +1,97 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <assert.h>
+#include "os/mynewt.h"
+
+#if MYNEWT_VAL(SHELL_TASK)
+#include "console/console.h"
+#include "shell/shell.h"
+#include "mem.h"
+
+/* flagged when less than this share (%) of a stack or pool is left */
+#define MEM_LOW_PCT     20
+
+static const char *
+mem_flag(uint32_t left, uint32_t total)
+{
+    return left * 100 < total * MEM_LOW_PCT ? " low" : "";
+}
+
+static void
+mem_tasks(void)
+{
+    struct os_task_info oti;
+    struct os_task *prev = NULL;
+    uint32_t size;
+    uint32_t used;
+
+    console_printf("%-12s %5s %6s %6s\n", "task", "prio", "stack", "peak");
+    while ((prev = os_task_info_get_next(prev, &oti)) != NULL) {
+        size = oti.oti_stksize * sizeof(os_stack_t);
+        used = oti.oti_stkusage * sizeof(os_stack_t);
+        console_printf("%-12s %5u %6lu %6lu%s\n", oti.oti_name,
+                       oti.oti_prio, (unsigned long)size, (unsigned long)used,
+                       mem_flag(size - used, size));
+    }
+}
+
+static void
+mem_pools(void)
+{
+    struct os_mempool_info omi;
+    struct os_mempool *prev = NULL;
+
+    console_printf("%-12s %5s %6s %6s %6s\n",
+                   "pool", "size", "blocks", "free", "min");
+    while ((prev = os_mempool_info_get_next(prev, &omi)) != NULL) {
+        console_printf("%-12s %5d %6d %6d %6d%s\n", omi.omi_name,
+                       omi.omi_block_size, omi.omi_num_blocks,
+                       omi.omi_num_free, omi.omi_min_free,
+                       mem_flag(omi.omi_min_free, omi.omi_num_blocks));
+    }
+}
+
+/*
+   Peak stack use of every task (from the fill pattern left by
+   os_task_init()) and the lowest free count every pool has seen since
+   boot.  Entries with less than MEM_LOW_PCT headroom are marked "low".
+ */
+static int
+mem_cli_cmd(int argc, char **argv)
+{
+    mem_tasks();
+    console_printf("\n");
+    mem_pools();
+    return 0;
+}
+
+static struct shell_cmd mem_cli = {
+    .sc_cmd = "mem",
+    .sc_cmd_func = mem_cli_cmd,
+};
+
+void
+mem_init(void)
+{
+    int rc;
+
+    rc = shell_cmd_register(&mem_cli);
+    assert(rc == 0);
+}
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "os/mynewt.h"
+
+#if MYNEWT_VAL(KB_SLEEP_MS) > 0
+#include "hal/hal_system.h"
+#include "nrf.h"
+#include "nimble-hid/nimble-hid.h"
+#include "sleep.h"
+
+/* time the link gets to go down before the radio is cut anyway */
+#define SLEEP_LINK_TIMEOUT_MS   500
+
+#ifdef NRF_P1
+#define SLEEP_GPIO_PORT(pin)    ((pin) > 31 ? NRF_P1 : NRF_P0)
+#else
+#define SLEEP_GPIO_PORT(pin)    NRF_P0
+#endif
+#define SLEEP_GPIO_INDEX(pin)   ((pin) & 0x1f)
+
+/*
+   RAM is not retained in System OFF unless asked for, per section: 4 kB
+   sections in RAM0..RAM7, 32 kB ones in RAM8 (nRF52840).
+ */
+static void
+sleep_retain(uint32_t addr)
+{
+    uint32_t off = addr - 0x20000000;
+    int block;
+    int section;
+
+    if (off < 64 * 1024) {
+        block = off / (8 * 1024);
+        section = off % (8 * 1024) / (4 * 1024);
+    } else {
+        block = 8;
+        section = (off - 64 * 1024) / (32 * 1024);
+    }
+    NRF_POWER->RAM[block].POWERSET = POWER_RAM_POWERSET_S0RETENTION_Msk << section;
+}
+
+void
+sleep_enter(const int *sense_pins, int npins)
+{
+    const void *ram;
+    size_t ram_len;
+    int i;
+
+    /* if the link is not down in time the host sees a supervision
+     * timeout instead */
+    (void)ble_hid_sleep(SLEEP_LINK_TIMEOUT_MS, &ram, &ram_len);
+
+    __disable_irq();
+
+    sleep_retain((uint32_t)ram);
+    sleep_retain((uint32_t)ram + ram_len - 1);
+
+    /* a key already down wakes the chip right away, nothing is lost */
+    for (i = 0; i < npins; i++) {
+        SLEEP_GPIO_PORT(sense_pins[i])->PIN_CNF[SLEEP_GPIO_INDEX(sense_pins[i])] =
+            (GPIO_PIN_CNF_DIR_Input << GPIO_PIN_CNF_DIR_Pos) |
+            (GPIO_PIN_CNF_INPUT_Connect << GPIO_PIN_CNF_INPUT_Pos) |
+            (GPIO_PIN_CNF_PULL_Pullup << GPIO_PIN_CNF_PULL_Pos) |
+            (GPIO_PIN_CNF_SENSE_Low << GPIO_PIN_CNF_SENSE_Pos);
+    }
+
+    __DSB();
+    NRF_POWER->SYSTEMOFF = 1;
+    /* emulated System OFF under a debugger carries on here */
+    while (1) {
+    }
+}
+
+bool
+sleep_woke(void)
+{
+    return hal_reset_cause() == HAL_RESET_SYS_OFF_INT;
+}
+#endif
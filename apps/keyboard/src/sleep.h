@@ -0,0 +1,37 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_KEYBOARD_SLEEP_
+#define H_KEYBOARD_SLEEP_
+
+#include <stdbool.h>
+
+/*
+   System OFF after KB_SLEEP_MS without a key (nRF52).  The matrix keeps
+   its rows driven and hands over the column pins, any key resets the
+   chip and the next boot takes the wake path.
+ */
+
+/* Does not return */
+void sleep_enter(const int *sense_pins, int npins);
+
+/* This boot is a wake from System OFF */
+bool sleep_woke(void);
+
+#endif
@@ -0,0 +1,34 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "os/mynewt.h"
+#include "modlog/modlog.h"
+#include "tusb.h"
+
+/*
+   The device is brought up by the tinyusb task in the background, main()
+   no longer waits for it.  Reports only go over BLE, the mount time is
+   logged to check that enumeration still completes without the delay.
+ */
+
+void
+tud_mount_cb(void)
+{
+    MODLOG_DFLT(INFO, "usb mounted %lu ms after boot\n",
+                (unsigned long)(os_get_uptime_usec() / 1000));
+}
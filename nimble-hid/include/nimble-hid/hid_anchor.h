@@ -0,0 +1,60 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_NIMBLE_HID_ANCHOR_
+#define H_NIMBLE_HID_ANCHOR_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Connection event anchor estimate.  The anchor of the link is taken from
+   the first radio event of each connection event and extended by the
+   connection interval, so the matrix scan can be placed just before the
+   next anchor instead of anywhere in the interval.
+ */
+
+void hid_anchor_init(void);
+/* Link (re)started with a new interval (1.25 ms units) and latency */
+void hid_anchor_connected(uint16_t itvl, uint16_t latency);
+void hid_anchor_disconnected(void);
+
+/*
+   Radio activity at cputime 'ts', may be called from an interrupt.  Samples
+   less than half an interval after the last accepted one belong to the
+   same connection event and are dropped.
+ */
+void hid_anchor_sample(uint32_t ts);
+
+/*
+   cputime at which the freshest key state should be committed:
+   BLE_HID_ANCHOR_LEAD_US before the first anchor that leaves at least that
+   much time after 'now'.  SYS_ENOENT when there is no link or no recent
+   anchor sample.
+ */
+int hid_anchor_next_release(uint32_t now, uint32_t *out_release);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_NIMBLE_HID_BENCH_
+#define H_NIMBLE_HID_BENCH_
+
+#include <stdint.h>
+#include "os/queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Benchmarks of the report path (BLE_HID_BENCH), run with the "hidbench"
+   shell command or the calls below, e.g. by apps/hid_sim against its fake
+   central (targets/hid_sim_bench).  Results are printed as one JSON
+   object per run.
+
+   hidbench [n]     ns/op of the report building blocks, n iterations.
+                    Reports are built but not sent.
+   hidbench replay  types a fixed text at 10, 100 and 1000 keys/s with
+                    the link as it is, per key cost and, when connected,
+                    the time until the notification is queued to the
+                    controller.
+   hidbench send n  sends the keyboard report n times back to back with
+                    each send method ("hidsend") in turn, reports/s
+                    delivered.  Needs a subscribed host.
+ */
+
+/* Operation timed by "hidbench [n]", called n times in the HID task */
+struct hid_bench_op {
+    const char *name;
+    void (*fn)(uint32_t i, void *arg);
+    void *arg;
+    SLIST_ENTRY(hid_bench_op) next;
+};
+
+/* Adds an operation of the application, e.g. its matrix to report path */
+void hid_bench_op_register(struct hid_bench_op *op);
+
+/*
+   "hidbench n", "hidbench replay" and "hidbench send n".  The run is done
+   in the HID task, which calls 'done' (may be NULL) once the results are
+   printed.  SYS_EBUSY while another run is going on.
+ */
+int hid_bench_run(uint32_t iters, void (*done)(void));
+int hid_bench_replay(void (*done)(void));
+int hid_bench_send(uint32_t count, void (*done)(void));
+
+/* Where the JSON goes, console_printf() by default */
+void hid_bench_set_output(int (*out)(const char *fmt, ...));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
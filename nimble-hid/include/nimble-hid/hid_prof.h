@@ -0,0 +1,90 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_NIMBLE_HID_PROF_
+#define H_NIMBLE_HID_PROF_
+
+#include <stdint.h>
+#include "os/os.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Hot path profiler (BLE_HID_PROF).  HID_PROF_SCOPE(id) at the top of a
+   block times the rest of the block, count, min, max and mean of every
+   probe are kept in a static table and printed (and cleared) with the
+   "prof" shell command.  Times are inclusive: a probe inside another
+   probe's block is counted in both.  Without BLE_HID_PROF the macros
+   are empty.  targets/chelizi_prof is the chelizi build with it on.
+ */
+
+#define HID_PROF_MATRIX_SCAN        0   /* matrix_scan(), without the anchor wait */
+#define HID_PROF_READ_COLS          1   /* read_cols_on_row(), one row */
+#define HID_PROF_KEYMAP             2   /* tmk action_for_key() */
+#define HID_PROF_SEND_REPORT        3   /* hid_send_report() */
+#define HID_PROF_GATT_READ          4   /* gatt_svr_attr_read() */
+#define HID_PROF_GATT_REPORT        5   /* ble_svc_report_access() */
+#define HID_PROF_GATT_CTRL          6   /* protocol mode and control point */
+#define HID_PROF_TRACE              7   /* one HID_TRACE() event, "prof trace" */
+#define HID_PROF_CNT                8
+
+#if MYNEWT_VAL(BLE_HID_PROF)
+
+#if MYNEWT_VAL(BLE_HID_PROF_DWT)
+/* ARMv7-M DWT cycle counter, started by hid_prof_init() */
+#define HID_PROF_NOW()  (*(volatile uint32_t *)0xe0001004)
+#else
+#define HID_PROF_NOW()  os_cputime_get32()
+#endif
+
+struct hid_prof_scope {
+    uint32_t start;
+    uint8_t id;
+};
+
+void hid_prof_add(uint8_t id, uint32_t ticks);
+
+static inline void
+hid_prof_scope_end(struct hid_prof_scope *scope)
+{
+    hid_prof_add(scope->id, HID_PROF_NOW() - scope->start);
+}
+
+/* One per block, the probe ends when the block is left */
+#define HID_PROF_SCOPE(probe)                                           \
+    struct hid_prof_scope hid_prof_scope_                               \
+        __attribute__((cleanup(hid_prof_scope_end))) =                  \
+        { .start = HID_PROF_NOW(), .id = (probe) }
+
+void hid_prof_init(void);
+
+#else
+
+#define HID_PROF_SCOPE(probe)
+#define hid_prof_init()
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
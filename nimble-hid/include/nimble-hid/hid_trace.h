@@ -0,0 +1,98 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_NIMBLE_HID_TRACE_
+#define H_NIMBLE_HID_TRACE_
+
+#include <stdint.h>
+#include "os/os.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Always-on event trace for latency debugging.  Every event is a 12 byte
+   record with a cputime stamp, written lock-free into a RAM ring and read
+   out with the hid trace SMP group (tools/hid_trace_decode.py turns the
+   dump into a Chrome trace timeline).
+ */
+
+/* Event tags, the meaning of the arguments is noted per tag */
+#define HID_TRACE_MATRIX_EDGE       1   /* a8: row, a32: changed columns */
+#define HID_TRACE_DEBOUNCE          2   /* a8: row, a16: 1 held back as a bounce, a32: columns */
+#define HID_TRACE_REPORT_SEND       3   /* a8: rc, a16: report handle_num, a32: 1 replayed */
+#define HID_TRACE_NOTIFY_TX         4   /* a8: status, a16: attr handle, a32: indication */
+#define HID_TRACE_CONN_UPDATE       5   /* a8: status, a16: interval, a32: latency << 16 | timeout */
+#define HID_TRACE_SUPERVISION_TO    6   /* a16: conn handle */
+#define HID_TRACE_CONNECT           7   /* a8: status, a16: conn handle */
+#define HID_TRACE_DISCONNECT        8   /* a16: conn handle, a32: reason */
+#define HID_TRACE_HOST_SWITCH       9   /* a8: slot, a32: 0 started, 1 host encrypted */
+#define HID_TRACE_PROF              10  /* a32: iteration, written by "prof trace" */
+
+struct hid_trace_rec {
+    uint32_t ts;
+    uint8_t tag;
+    uint8_t a8;
+    uint16_t a16;
+    uint32_t a32;
+};
+
+#if MYNEWT_VAL(BLE_HID_TRACE_ENTRIES) > 0
+
+#if MYNEWT_VAL(BLE_HID_TRACE_ENTRIES) & (MYNEWT_VAL(BLE_HID_TRACE_ENTRIES) - 1)
+#error "BLE_HID_TRACE_ENTRIES must be a power of two"
+#endif
+
+extern struct hid_trace_rec hid_trace_ring[];
+/* total number of events ever recorded */
+extern uint32_t hid_trace_head;
+
+static inline void
+hid_trace(uint8_t tag, uint8_t a8, uint16_t a16, uint32_t a32)
+{
+    struct hid_trace_rec *rec;
+    uint32_t idx;
+
+    idx = __atomic_fetch_add(&hid_trace_head, 1, __ATOMIC_RELAXED);
+    rec = &hid_trace_ring[idx & (MYNEWT_VAL(BLE_HID_TRACE_ENTRIES) - 1)];
+    rec->ts = os_cputime_get32();
+    rec->tag = tag;
+    rec->a8 = a8;
+    rec->a16 = a16;
+    rec->a32 = a32;
+}
+
+#define HID_TRACE(tag, a8, a16, a32) \
+    hid_trace((tag), (uint8_t)(a8), (uint16_t)(a16), (uint32_t)(a32))
+
+void hid_trace_init(void);
+
+#else
+
+#define HID_TRACE(tag, a8, a16, a32)
+#define hid_trace_init()
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,31 +1,101 @@
 /*
- * This is a sample header file for your package.  Feel free to delete this
- * file, or rename it.
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
  *
- * Package include files are located under the <pkg>/include/<pkg-name>
- * directory.  When referencing include files in this directory, the
- * include statement should be:
+ *  http://www.apache.org/licenses/LICENSE-2.0
  *
- * #include "pkg-name/file-name.h"
- *
- * If you are referencing package includes from another package, you must
- * list the package who's includes you are referencing as a dependency in
- * the pkg.yml file.  By adding the package as a dependency, newt will
- * automatically add -I<pkg>/include to the CFLAGS when compiling your
- * package.
- *
- * If you want to provide architecture specific header files, you can do
- * this by putting it into the "arch/your-arch/pkg-name".  For example,
- * to have a header file that is overrode for Cortex-M4 architectures, you
- * would put the file in the following location:
- *
- * * <your-pkg>/include/<your-pkg>/arch/cortex_m4/<your-pkg>/file-name.h
- *
- * And you can then include it with the following include statement:
- *
- * #include "pkg-name/file-name.h"
- *
- * And depending on what architecture is specified (usually controlled by
- * BSP or MCU definition), the correct architecture directory will be
- * included.
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_NIMBLE_HID_
+#define H_NIMBLE_HID_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Host slots (BLE_HID_BOND_SLOTS).  Each slot remembers one bonded host,
+   the keyboard is connected to the host of the active slot only.  A new
+   host may only pair into the active slot while it is empty, or after
+   ble_hid_host_pair() selected it for pairing.
+ */
+
+/* Active slot number */
+int ble_hid_host_active(void);
+
+/*
+   Makes 'slot' the active slot: drops the current link and advertises
+   directed to the slot's host, or undirected if the slot is empty.  Safe
+   to call from any task, the work is done on the BLE host event queue.
+ */
+int ble_hid_host_switch(int slot);
+
+/*
+   Like ble_hid_host_switch(), and lets a new host pair into 'slot'.  Its
+   current host and bond are kept until the new host has paired.
+ */
+int ble_hid_host_pair(int slot);
+
+/* Forgets the host of 'slot' and deletes its bond */
+int ble_hid_host_unpair(int slot);
+
+/*
+   Test hook: makes the host with identity address 'addr' of 'addr_type'
+   the host of 'slot', in RAM only, as if the slot had been loaded from
+   the config store.  The bond itself has to be in the NimBLE store.
+ */
+int hid_bond_seed(int slot, uint8_t addr_type, const uint8_t *addr);
+
+/*
+   Test hook (BLE_HID_RETAIN): fills retained RAM as ble_hid_sleep() would
+   with 'slot' active and its host at 'addr', and makes the next
+   ble_hid_init() take the System OFF wake path whatever the reset cause.
+   Call before sysinit().
+ */
+int hid_bond_seed_wake(int slot, uint8_t addr_type, const uint8_t *addr);
+
+/*
+   Before System OFF (BLE_HID_RETAIN): keeps the active host in retained
+   RAM, stops advertising and drops the link.  Blocks the caller until the
+   link is down or 'timeout_ms' passed (SYS_ETIMEOUT).  '*ram' and
+   '*ram_len' are the block the caller has to keep powered; after the wake
+   reset the keyboard advertises directed to that host first.
+ */
+int ble_hid_sleep(uint32_t timeout_ms, const void **ram, size_t *ram_len);
+
+/* 8 byte boot keyboard input report, called by tmk's host driver */
+int hid_send_keyboard_report(const void *report, size_t report_size);
+
+/* ms from boot to the first report delivered over BLE, 0 if none yet */
+uint32_t hid_boot_report_time(void);
+
+/* us from the last connection to its first delivered report, 0 if none yet */
+uint32_t hid_conn_report_time(void);
+
+/*
+   The host suspended the device through the HID Control Point.  The
+   scan loop should slow down, the first key pressed sends its report
+   as remote wake and ends the suspend.
  */
+bool ble_hid_suspended(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
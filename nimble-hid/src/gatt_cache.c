@@ -0,0 +1,477 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <assert.h>
+#include <string.h>
+
+#include "os/endian.h"
+#include "tinycrypt/cmac_mode.h"
+#include "tinycrypt/constants.h"
+#include "gatt_svr.h"
+#include "gatt_cache.h"
+#include "hid_bond.h"
+
+/* Attribute types covered by the hash (Core spec Vol 3 Part G 7.3) */
+#define ATT_TYPE_PRIMARY_SVC        0x2800
+#define ATT_TYPE_SECONDARY_SVC      0x2801
+#define ATT_TYPE_INCLUDE            0x2802
+#define ATT_TYPE_CHR                0x2803
+#define ATT_TYPE_CHR_EXT_PROP       0x2900
+#define ATT_TYPE_CHR_USER_DESC      0x2901
+#define ATT_TYPE_CLT_CFG            0x2902
+#define ATT_TYPE_SRV_CFG            0x2903
+#define ATT_TYPE_PRES_FMT           0x2904
+#define ATT_TYPE_AGGR_FMT           0x2905
+
+#define CHR_PROP_EXTENDED           0x80
+
+/* services seen so far, for the end group handles of include declarations */
+#define GATT_CACHE_MAX_SVCS         8
+
+static struct {
+    const struct ble_gatt_svc_def *def;
+    uint16_t start;
+    uint16_t end;
+} gatt_cache_svc_tbl[GATT_CACHE_MAX_SVCS];
+static uint8_t gatt_cache_num_svcs;
+/* last attribute handle registered */
+static uint16_t gatt_cache_last_handle;
+/* Extended Properties value of the last characteristic registered */
+static uint16_t gatt_cache_ext_prop;
+
+static struct tc_aes_key_sched_struct gatt_cache_sched;
+static struct tc_cmac_struct gatt_cache_cmac;
+static bool gatt_cache_hash_started;
+static bool gatt_cache_hash_done;
+static uint8_t gatt_cache_db_hash[GATT_CACHE_DB_HASH_LEN];
+
+static uint16_t gatt_cache_svc_changed_handle;
+
+static struct {
+    uint16_t conn_handle;
+    uint8_t used;
+    uint8_t features;
+    /* host slot of a bonded client, -1 until the link is encrypted */
+    int8_t slot;
+    uint8_t sc_indicate;
+    /* the host last saw another database, Service Changed is pending */
+    uint8_t unaware;
+} gatt_cache_clt[MYNEWT_VAL(BLE_MAX_CONNECTIONS)];
+
+static void
+gatt_cache_hash_attr(uint16_t handle, uint16_t type, const void *val, int val_len)
+{
+    uint8_t hdr[4];
+
+    if (!gatt_cache_hash_started) {
+        static const uint8_t zero_key[16];
+
+        tc_cmac_setup(&gatt_cache_cmac, zero_key, &gatt_cache_sched);
+        gatt_cache_hash_started = true;
+    }
+
+    put_le16(hdr, handle);
+    put_le16(hdr + 2, type);
+    tc_cmac_update(&gatt_cache_cmac, hdr, sizeof(hdr));
+    if (val_len) {
+        tc_cmac_update(&gatt_cache_cmac, val, val_len);
+    }
+    gatt_cache_last_handle = handle;
+}
+
+static int
+gatt_cache_svc_idx(const struct ble_gatt_svc_def *def)
+{
+    for (int i = 0; i < gatt_cache_num_svcs; ++i) {
+        if (gatt_cache_svc_tbl[i].def == def) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void
+gatt_cache_close_svc(void)
+{
+    if (gatt_cache_num_svcs) {
+        gatt_cache_svc_tbl[gatt_cache_num_svcs - 1].end = gatt_cache_last_handle;
+    }
+}
+
+static void
+gatt_cache_register_svc(uint16_t handle, const struct ble_gatt_svc_def *def)
+{
+    uint8_t val[16];
+    int len;
+
+    gatt_cache_close_svc();
+    assert(gatt_cache_num_svcs < GATT_CACHE_MAX_SVCS);
+    gatt_cache_svc_tbl[gatt_cache_num_svcs].def = def;
+    gatt_cache_svc_tbl[gatt_cache_num_svcs].start = handle;
+    gatt_cache_num_svcs++;
+
+    len = ble_uuid_flat(def->uuid, val) == 0 ? ble_uuid_length(def->uuid) : 0;
+    gatt_cache_hash_attr(handle,
+                         def->type == BLE_GATT_SVC_TYPE_PRIMARY ?
+                         ATT_TYPE_PRIMARY_SVC : ATT_TYPE_SECONDARY_SVC,
+                         val, len);
+
+    /* include declarations follow the service declaration without a
+       register callback; included services are always registered first */
+    for (int i = 0; def->includes != NULL && def->includes[i] != NULL; ++i) {
+        int idx = gatt_cache_svc_idx(def->includes[i]);
+
+        assert(idx >= 0);
+        put_le16(val, gatt_cache_svc_tbl[idx].start);
+        put_le16(val + 2, gatt_cache_svc_tbl[idx].end);
+        len = 4;
+        if (def->includes[i]->uuid->type == BLE_UUID_TYPE_16) {
+            put_le16(val + 4, ble_uuid_u16(def->includes[i]->uuid));
+            len += 2;
+        }
+        gatt_cache_hash_attr(gatt_cache_last_handle + 1, ATT_TYPE_INCLUDE, val, len);
+    }
+}
+
+static void
+gatt_cache_register_chr(uint16_t def_handle, uint16_t val_handle,
+                        const struct ble_gatt_chr_def *chr)
+{
+    uint8_t val[19];
+    int len;
+
+    /* same mapping as ble_gatts_chr_properties() */
+    val[0] = chr->flags & 0x7F;
+    if (chr->flags & (BLE_GATT_CHR_F_RELIABLE_WRITE | BLE_GATT_CHR_F_AUX_WRITE)) {
+        val[0] |= CHR_PROP_EXTENDED;
+    }
+    gatt_cache_ext_prop = (chr->flags & BLE_GATT_CHR_F_RELIABLE_WRITE ? 0x0001 : 0) |
+                          (chr->flags & BLE_GATT_CHR_F_AUX_WRITE ? 0x0002 : 0);
+    put_le16(val + 1, val_handle);
+    len = ble_uuid_flat(chr->uuid, val + 3) == 0 ? ble_uuid_length(chr->uuid) : 0;
+    gatt_cache_hash_attr(def_handle, ATT_TYPE_CHR, val, 3 + len);
+    gatt_cache_last_handle = val_handle;
+
+    /* the host adds the CCCD right after the value */
+    if (chr->flags & (BLE_GATT_CHR_F_NOTIFY | BLE_GATT_CHR_F_INDICATE)) {
+        gatt_cache_hash_attr(val_handle + 1, ATT_TYPE_CLT_CFG, NULL, 0);
+    }
+}
+
+static void
+gatt_cache_register_dsc(uint16_t handle, const struct ble_gatt_dsc_def *dsc)
+{
+    uint16_t type = dsc->uuid->type == BLE_UUID_TYPE_16 ? ble_uuid_u16(dsc->uuid) : 0;
+    uint8_t val[2];
+
+    switch (type) {
+    case ATT_TYPE_CHR_USER_DESC:
+    case ATT_TYPE_CLT_CFG:
+    case ATT_TYPE_SRV_CFG:
+    case ATT_TYPE_PRES_FMT:
+    case ATT_TYPE_AGGR_FMT:
+        gatt_cache_hash_attr(handle, type, NULL, 0);
+        break;
+    case ATT_TYPE_CHR_EXT_PROP:
+        /* the descriptor has to report the characteristic's flags, take
+           the value from those rather than from its access callback */
+        put_le16(val, gatt_cache_ext_prop);
+        gatt_cache_hash_attr(handle, type, val, sizeof(val));
+        break;
+    default:
+        gatt_cache_last_handle = handle;
+        break;
+    }
+}
+
+void
+gatt_cache_register(const struct ble_gatt_register_ctxt *ctxt)
+{
+    switch (ctxt->op) {
+    case BLE_GATT_REGISTER_OP_SVC:
+        gatt_cache_register_svc(ctxt->svc.handle, ctxt->svc.svc_def);
+        break;
+    case BLE_GATT_REGISTER_OP_CHR:
+        gatt_cache_register_chr(ctxt->chr.def_handle, ctxt->chr.val_handle,
+                                ctxt->chr.chr_def);
+        break;
+    case BLE_GATT_REGISTER_OP_DSC:
+        gatt_cache_register_dsc(ctxt->dsc.handle, ctxt->dsc.dsc_def);
+        break;
+    }
+}
+
+/* the database is complete once a peer can read it */
+static const uint8_t *
+gatt_cache_db_hash_get(void)
+{
+    if (!gatt_cache_hash_done) {
+        gatt_cache_close_svc();
+        tc_cmac_final(gatt_cache_db_hash, &gatt_cache_cmac);
+        /* CMAC output is big endian, ATT values are little endian */
+        swap_in_place(gatt_cache_db_hash, sizeof(gatt_cache_db_hash));
+        gatt_cache_hash_done = true;
+    }
+    return gatt_cache_db_hash;
+}
+
+static int
+gatt_cache_clt_idx(uint16_t conn_handle, bool alloc)
+{
+    int free_idx = -1;
+
+    for (int i = 0; i < MYNEWT_VAL(BLE_MAX_CONNECTIONS); ++i) {
+        if (gatt_cache_clt[i].used && gatt_cache_clt[i].conn_handle == conn_handle) {
+            return i;
+        }
+        if (!gatt_cache_clt[i].used && free_idx < 0) {
+            free_idx = i;
+        }
+    }
+    if (alloc && free_idx >= 0) {
+        memset(&gatt_cache_clt[free_idx], 0, sizeof(gatt_cache_clt[0]));
+        gatt_cache_clt[free_idx].used = 1;
+        gatt_cache_clt[free_idx].conn_handle = conn_handle;
+        gatt_cache_clt[free_idx].slot = -1;
+        return free_idx;
+    }
+    return -1;
+}
+
+void
+gatt_cache_conn_closed(uint16_t conn_handle)
+{
+    int idx = gatt_cache_clt_idx(conn_handle, false);
+
+    if (idx >= 0) {
+        gatt_cache_clt[idx].used = 0;
+    }
+}
+
+/* the host's state as it will be once it is change aware */
+static void
+gatt_cache_clt_save(int idx)
+{
+    struct hid_bond_gatt gatt;
+
+    gatt.features = gatt_cache_clt[idx].features;
+    memcpy(gatt.db_hash, gatt_cache_db_hash_get(), sizeof(gatt.db_hash));
+    hid_bond_gatt_set(gatt_cache_clt[idx].slot, &gatt);
+}
+
+/* Service Changed over the whole handle range, the host rediscovers */
+static void
+gatt_cache_indicate_changed(int idx)
+{
+    struct os_mbuf *om;
+    uint8_t val[4];
+    int rc;
+
+    put_le16(val, 0x0001);
+    put_le16(val + 2, 0xFFFF);
+    om = ble_hs_mbuf_from_flat(val, sizeof(val));
+    if (om == NULL) {
+        return;
+    }
+    rc = ble_gattc_indicate_custom(gatt_cache_clt[idx].conn_handle,
+                                   gatt_cache_svc_changed_handle, om);
+    BLE_HID_LOG_INFO("service changed; conn_handle=%d rc=%d\n",
+                     gatt_cache_clt[idx].conn_handle, rc);
+}
+
+void
+gatt_cache_bonded(uint16_t conn_handle, int slot)
+{
+    const struct hid_bond_gatt *gatt = hid_bond_gatt_get(slot);
+    static const uint8_t zero_hash[GATT_CACHE_DB_HASH_LEN];
+    int idx;
+
+    if (gatt == NULL) {
+        return;
+    }
+    idx = gatt_cache_clt_idx(conn_handle, true);
+    if (idx < 0) {
+        return;
+    }
+
+    gatt_cache_clt[idx].slot = slot;
+    /* features written before encryption add to the stored ones */
+    gatt_cache_clt[idx].features |= gatt->features;
+
+    if (!memcmp(gatt->db_hash, zero_hash, sizeof(zero_hash))) {
+        /* first encrypted link, the host discovered this database */
+        gatt_cache_clt_save(idx);
+        return;
+    }
+    if (memcmp(gatt->db_hash, gatt_cache_db_hash_get(), GATT_CACHE_DB_HASH_LEN)) {
+        gatt_cache_clt[idx].unaware = 1;
+        if (gatt_cache_clt[idx].sc_indicate) {
+            gatt_cache_indicate_changed(idx);
+        }
+    } else if (gatt_cache_clt[idx].features != gatt->features) {
+        gatt_cache_clt_save(idx);
+    }
+}
+
+void
+gatt_cache_subscribe(uint16_t conn_handle, uint16_t attr_handle, bool indicate)
+{
+    int idx;
+
+    if (attr_handle != gatt_cache_svc_changed_handle) {
+        return;
+    }
+    idx = gatt_cache_clt_idx(conn_handle, indicate);
+    if (idx < 0) {
+        return;
+    }
+
+    gatt_cache_clt[idx].sc_indicate = indicate;
+    /* the bonded host's subscription is restored after the encryption
+       change, the indication goes out from here then */
+    if (indicate && gatt_cache_clt[idx].unaware) {
+        gatt_cache_indicate_changed(idx);
+    }
+}
+
+void
+gatt_cache_notify_tx(uint16_t conn_handle, uint16_t attr_handle, int status)
+{
+    int idx;
+
+    if (attr_handle != gatt_cache_svc_changed_handle) {
+        return;
+    }
+    idx = gatt_cache_clt_idx(conn_handle, false);
+    if (idx < 0 || !gatt_cache_clt[idx].unaware) {
+        return;
+    }
+
+    /* the host confirmed the indication and is change aware now */
+    if (status == BLE_HS_EDONE) {
+        gatt_cache_clt[idx].unaware = 0;
+        gatt_cache_clt_save(idx);
+    }
+}
+
+static int
+gatt_cache_svc_changed_access(uint16_t conn_handle, uint16_t attr_handle,
+                              struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    /* indicate only, the value is never read */
+    return BLE_ATT_ERR_UNLIKELY;
+}
+
+static int
+gatt_cache_clt_feat_access(uint16_t conn_handle, uint16_t attr_handle,
+                           struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    uint8_t features = 0;
+    int idx;
+    int rc;
+
+    idx = gatt_cache_clt_idx(conn_handle, false);
+
+    switch (ctxt->op) {
+    case BLE_GATT_ACCESS_OP_READ_CHR:
+        if (idx >= 0) {
+            features = gatt_cache_clt[idx].features;
+        }
+        rc = os_mbuf_append(ctxt->om, &features, sizeof(features));
+        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+
+    case BLE_GATT_ACCESS_OP_WRITE_CHR:
+        if (OS_MBUF_PKTLEN(ctxt->om) < 1) {
+            return BLE_ATT_ERR_INVALID_ATTR_VALUE_LEN;
+        }
+        os_mbuf_copydata(ctxt->om, 0, 1, &features);
+        features &= GATT_CACHE_CLT_FEAT_ROBUST_CACHING;
+
+        if (idx >= 0) {
+            /* a client may not clear a feature it enabled */
+            if (gatt_cache_clt[idx].features & ~features) {
+                return BLE_ATT_ERR_VALUE_NOT_ALLOWED;
+            }
+        } else if (features) {
+            idx = gatt_cache_clt_idx(conn_handle, true);
+            if (idx < 0) {
+                return BLE_ATT_ERR_INSUFFICIENT_RES;
+            }
+        }
+        if (idx >= 0) {
+            gatt_cache_clt[idx].features = features;
+            /* persisted for a bonded host once it is change aware */
+            if (gatt_cache_clt[idx].slot >= 0 && !gatt_cache_clt[idx].unaware) {
+                gatt_cache_clt_save(idx);
+            }
+        }
+        BLE_HID_LOG_INFO("client features; conn_handle=%d features=%02x\n",
+                         conn_handle, features);
+        return 0;
+
+    default:
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+}
+
+static int
+gatt_cache_db_hash_access(uint16_t conn_handle, uint16_t attr_handle,
+                          struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    int rc;
+
+    if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR) {
+        return BLE_ATT_ERR_UNLIKELY;
+    }
+
+    rc = os_mbuf_append(ctxt->om, gatt_cache_db_hash_get(), GATT_CACHE_DB_HASH_LEN);
+    return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
+
+const struct ble_gatt_svc_def gatt_cache_svcs[] = {
+    {
+        /*** Generic Attribute Service */
+        .type = BLE_GATT_SVC_TYPE_PRIMARY,
+        .uuid = BLE_UUID16_DECLARE(GATT_CACHE_SVC_UUID16),
+        .characteristics = (struct ble_gatt_chr_def[]) {
+            {
+                .uuid = BLE_UUID16_DECLARE(GATT_CACHE_CHR_SVC_CHANGED_UUID16),
+                .access_cb = gatt_cache_svc_changed_access,
+                .val_handle = &gatt_cache_svc_changed_handle,
+                .flags = BLE_GATT_CHR_F_INDICATE,
+            },
+            {
+                .uuid = BLE_UUID16_DECLARE(GATT_CACHE_CHR_CLT_FEAT_UUID16),
+                .access_cb = gatt_cache_clt_feat_access,
+                .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
+            },
+            {
+                .uuid = BLE_UUID16_DECLARE(GATT_CACHE_CHR_DB_HASH_UUID16),
+                .access_cb = gatt_cache_db_hash_access,
+                .flags = BLE_GATT_CHR_F_READ,
+            },
+            {
+                0, /* No more characteristics in this service. */
+            }
+        },
+    },
+
+    {
+        0, /* No more services. */
+    },
+};
@@ -0,0 +1,74 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_GATT_CACHE_
+#define H_GATT_CACHE_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   GATT service (0x1801) with Service Changed, Client Supported Features
+   and Database Hash, so hosts supporting robust caching can skip service
+   discovery on reconnect.  Replaces the NimBLE services/gatt package.
+ */
+
+#define GATT_CACHE_SVC_UUID16               0x1801
+#define GATT_CACHE_CHR_SVC_CHANGED_UUID16   0x2A05
+#define GATT_CACHE_CHR_CLT_FEAT_UUID16      0x2B29
+#define GATT_CACHE_CHR_DB_HASH_UUID16       0x2B2A
+
+/* Client Supported Features bits */
+#define GATT_CACHE_CLT_FEAT_ROBUST_CACHING  0x01
+
+#define GATT_CACHE_DB_HASH_LEN              16
+
+struct ble_gatt_svc_def;
+struct ble_gatt_register_ctxt;
+
+extern const struct ble_gatt_svc_def gatt_cache_svcs[];
+
+/* Feed one registered attribute into the database hash, called from the
+   gatts register callback; attributes arrive in handle order. */
+void gatt_cache_register(const struct ble_gatt_register_ctxt *ctxt);
+
+/* Forget the Client Supported Features of a closed connection */
+void gatt_cache_conn_closed(uint16_t conn_handle);
+
+/*
+   The link of the bonded host of 'slot' got encrypted.  Loads the host's
+   Client Supported Features and, if the database hash differs from the
+   one the host last saw, indicates Service Changed once it subscribed.
+   The features and the hash are persisted with the host slot.
+ */
+void gatt_cache_bonded(uint16_t conn_handle, int slot);
+
+/* From BLE_GAP_EVENT_SUBSCRIBE and BLE_GAP_EVENT_NOTIFY_TX */
+void gatt_cache_subscribe(uint16_t conn_handle, uint16_t attr_handle, bool indicate);
+void gatt_cache_notify_tx(uint16_t conn_handle, uint16_t attr_handle, int status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
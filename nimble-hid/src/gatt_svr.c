@@ -19,7 +19,10 @@
 #include <assert.h>
 
 #include "gatt_svr.h"
+#include "gatt_cache.h"
 #include "hid_func.h"
+#include "hid_log.h"
+#include "nimble-hid/hid_prof.h"
 
 static int gatt_svr_chr_write(struct os_mbuf *om, uint16_t min_len, uint16_t max_len,
                               void *dst, uint16_t *len);
@@ -45,99 +48,81 @@ gatt_svr_chr_write(struct os_mbuf *om, uint16_t min_len, uint16_t max_len,
 }
 
 int
-hid_svr_chr_access(uint16_t conn_handle, uint16_t attr_handle,
-                   struct ble_gatt_access_ctxt *ctxt,
-                   void *arg)
+gatt_svr_attr_read(uint16_t conn_handle, uint16_t attr_handle,
+                   struct ble_gatt_access_ctxt *ctxt, void *arg)
 {
-    uint16_t uuid16 = ble_uuid_u16(ctxt->chr->uuid);
+    HID_PROF_SCOPE(HID_PROF_GATT_READ);
+    const struct gatt_svr_attr *attr = arg;
     int rc;
 
-    BLE_HID_LOG_INFO("%s: UUID %04X attr %04X arg %d op %d\n", __FUNCTION__,
-            uuid16, attr_handle, (int)arg, ctxt->op);
-
-    switch (uuid16) {
+    HID_HLOG_DEBUG(HID_LOG_ATTR_READ, attr_handle, ctxt->op, 0);
 
-    case GATT_UUID_HID_INFORMATION:
-        if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR) {
-            BLE_HID_LOG_ERROR("invalid op %d\n", ctxt->op);
-            break;
-        }
-        rc = os_mbuf_append(ctxt->om, hid_info,
-                            HID_INFORMATION_LEN);
-        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
-
-    case GATT_UUID_HID_CONTROL_POINT: {
-        if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_CHR) {
-            BLE_HID_LOG_ERROR("invalid op %d\n", ctxt->op);
-            break;
-        }
+    if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR &&
+        ctxt->op != BLE_GATT_ACCESS_OP_READ_DSC) {
+        BLE_HID_LOG_ERROR("invalid op %d\n", ctxt->op);
+        return BLE_ATT_ERR_UNLIKELY;
+    }
 
-        uint8_t new_suspend_state;
+    rc = os_mbuf_append(ctxt->om, attr->buf, attr->len);
+    return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
 
-        rc = gatt_svr_chr_write(ctxt->om, 1, 1, &new_suspend_state, NULL);
-        if (!rc) {
-            bool old_state = hid_set_suspend((bool) new_suspend_state);
+int
+hid_ctrl_point_access(uint16_t conn_handle, uint16_t attr_handle,
+                      struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    HID_PROF_SCOPE(HID_PROF_GATT_CTRL);
+    uint8_t new_suspend_state;
+    int rc;
 
-            BLE_HID_LOG_INFO("HID_CONTROL_POINT received new suspend state: %d, old state is: %d",
-                             (int)new_suspend_state, (int)old_state);
-        }
-        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    if (ctxt->op != BLE_GATT_ACCESS_OP_WRITE_CHR) {
+        BLE_HID_LOG_ERROR("invalid op %d\n", ctxt->op);
+        return BLE_ATT_ERR_UNLIKELY;
     }
 
-    case GATT_UUID_HID_REPORT_MAP: {
-        if (ctxt->op != BLE_GATT_ACCESS_OP_READ_CHR) {
-            BLE_HID_LOG_ERROR("invalid op %d\n", ctxt->op);
-            break;
-        }
-
-        rc = os_mbuf_append(ctxt->om, hid_report_map, hid_report_map_size);
-        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+    rc = gatt_svr_chr_write(ctxt->om, 1, 1, &new_suspend_state, NULL);
+    if (!rc && new_suspend_state > HID_CMD_EXIT_SUSPEND) {
+        return BLE_ATT_ERR_VALUE_NOT_ALLOWED;
     }
+    if (!rc) {
+        /* 0 is Suspend, 1 Exit Suspend */
+        bool old_state = hid_set_suspend(new_suspend_state == HID_CMD_SUSPEND);
 
-    case GATT_UUID_EXT_RPT_REF_DESCR: {
-        if (ctxt->op != BLE_GATT_ACCESS_OP_READ_DSC) {
-            BLE_HID_LOG_ERROR("invalid op %d", ctxt->op);
-            break;
-        }
-
-        rc = os_mbuf_append(ctxt->om, (uint8_t *)&hid_ext_report_ref_desc,
-            sizeof(hid_ext_report_ref_desc));
-        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+        BLE_HID_LOG_INFO("HID_CONTROL_POINT received new suspend state: %d, old state is: %d",
+                         (int)new_suspend_state, (int)old_state);
     }
+    return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
+}
 
-    case GATT_UUID_HID_PROTO_MODE: {
-        if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR) {
-            rc = os_mbuf_append(ctxt->om, &hid_protocol_mode,
-                                sizeof(hid_protocol_mode));
-            return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
-
-        } else if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
-
-            uint8_t new_protocol_mode;
+int
+hid_proto_mode_access(uint16_t conn_handle, uint16_t attr_handle,
+                      struct ble_gatt_access_ctxt *ctxt, void *arg)
+{
+    HID_PROF_SCOPE(HID_PROF_GATT_CTRL);
+    uint8_t new_protocol_mode;
+    int rc;
 
-            rc = gatt_svr_chr_write(ctxt->om, 1, sizeof(new_protocol_mode),
-                &new_protocol_mode, NULL);
-            if (!rc) {
-                hid_protocol_mode = new_protocol_mode;
-                /* send true if new mode is boot mode, else guess */
-                hid_set_report_mode(hid_protocol_mode == HID_PROTOCOL_MODE_BOOT);
+    switch (ctxt->op) {
+    case BLE_GATT_ACCESS_OP_READ_CHR:
+        return gatt_svr_attr_read(conn_handle, attr_handle, ctxt, arg);
 
-                BLE_HID_LOG_INFO("Received new protocol mode: %d\n",
-                                 (int)new_protocol_mode);
-            }
+    case BLE_GATT_ACCESS_OP_WRITE_CHR:
+        rc = gatt_svr_chr_write(ctxt->om, 1, sizeof(new_protocol_mode),
+            &new_protocol_mode, NULL);
+        if (!rc) {
+            hid_protocol_mode = new_protocol_mode;
+            /* send true if new mode is boot mode, else guess */
+            hid_set_report_mode(hid_protocol_mode == HID_PROTOCOL_MODE_BOOT);
 
-            return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
-        } else {
-            BLE_HID_LOG_ERROR("invalid op %d\n", ctxt->op);
+            BLE_HID_LOG_INFO("Received new protocol mode: %d\n",
+                             (int)new_protocol_mode);
         }
-        return BLE_ATT_ERR_INSUFFICIENT_RES;
-    }
+        return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
 
     default:
-        BLE_HID_LOG_ERROR("invalid UUID %02X\n", uuid16);
-        break;
+        BLE_HID_LOG_ERROR("invalid op %d\n", ctxt->op);
+        return BLE_ATT_ERR_INSUFFICIENT_RES;
     }
-    return BLE_ATT_ERR_UNLIKELY;
 }
 
 /* Report access function for all reports */
@@ -146,212 +131,83 @@ ble_svc_report_access(uint16_t conn_handle, uint16_t attr_handle,
                       struct ble_gatt_access_ctxt *ctxt,
                       void *arg)
 {
-    uint16_t uuid16 = ble_uuid_u16(ctxt->chr->uuid);
-    int handle_num = (int) arg;
-    int rc = BLE_ATT_ERR_UNLIKELY;
-
-    BLE_HID_LOG_INFO("%s: UUID %04X attr %04X arg %d op %d\n",
-            __FUNCTION__, uuid16, attr_handle, (int)arg, ctxt->op);
-
-    do {
-        /* Report reference descriptors */
-        if (uuid16 == GATT_UUID_RPT_REF_DESCR) {
-            if (ctxt->op != BLE_GATT_ACCESS_OP_READ_DSC) {
-                BLE_HID_LOG_ERROR("invalid op %d\n", ctxt->op);
-                break;
-            }
-            int rpt_ind = -1;
-
-            for (int i = 0; i < hid_report_ref_data_count; ++i) {
-                if ((int)hid_report_ref_data[i].id == handle_num) {
-                    rpt_ind = i;
-                    break;
-                }
-            }
-            if (rpt_ind != -1) {
-                rc = os_mbuf_append(ctxt->om,
-                                    (uint8_t *)hid_report_ref_data[rpt_ind].hidReportRef,
-                    HID_REPORT_REF_LEN);
-                if (rc) {
-                    rc = BLE_ATT_ERR_INSUFFICIENT_RES;
-                }
-            } else {
-                rc = BLE_ATT_ERR_UNLIKELY;
-            }
+    HID_PROF_SCOPE(HID_PROF_GATT_REPORT);
+    const struct gatt_svr_attr *attr = arg;
+    int rc;
 
-            break;
-        }
+    HID_HLOG_DEBUG(HID_LOG_REPORT_ACCESS, attr_handle, attr->handle_num, ctxt->op);
 
-        /* reports read */
-        if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR && (
-                (uuid16 == GATT_UUID_HID_REPORT) ||
-                (uuid16 == GATT_UUID_HID_BT_MOUSE_INPUT) ||
-                (uuid16 == GATT_UUID_HID_BT_KB_INPUT) ||
-                (uuid16 == GATT_UUID_HID_BT_KB_OUTPUT))) {
-            rc = hid_read_buffer(ctxt->om, handle_num);
-            if (rc) {
-                rc = BLE_ATT_ERR_INSUFFICIENT_RES;
-            }
-            break;
-        }
+    switch (ctxt->op) {
+    case BLE_GATT_ACCESS_OP_READ_CHR:
+        rc = hid_read_buffer(ctxt->om, attr->handle_num);
+        break;
 
+    case BLE_GATT_ACCESS_OP_WRITE_CHR:
         /* keyboard out report (leds in/out) */
-        if (ctxt->op == BLE_GATT_ACCESS_OP_WRITE_CHR) {
-            switch (handle_num) {
-            case HANDLE_HID_KB_OUT_REPORT:
-            case HANDLE_HID_FEATURE_REPORT:
-                rc = hid_write_buffer(ctxt->om, handle_num);
-                if (rc) {
-                    rc = BLE_ATT_ERR_INSUFFICIENT_RES;
-                }
-                break;
-            default:
-                rc = BLE_ATT_ERR_INSUFFICIENT_RES;
-            }
+        switch (attr->handle_num) {
+        case HANDLE_HID_KB_OUT_REPORT:
+        case HANDLE_HID_FEATURE_REPORT:
+            rc = hid_write_buffer(ctxt->om, attr->handle_num);
             break;
-        }
-
-    } while (0);
-
-    return rc;
-}
-
-/**
- * BAS access function
- */
-int
-ble_svc_battery_access(uint16_t conn_handle, uint16_t attr_handle,
-                       struct ble_gatt_access_ctxt *ctxt,
-                       void *arg)
-{
-    uint16_t uuid16 = ble_uuid_u16(ctxt->chr->uuid);
-    int rc = 0;
-
-    BLE_HID_LOG_INFO("%s: UUID %04X attr %04X arg %d op %d\n",
-            __FUNCTION__, uuid16, attr_handle, (int) arg, ctxt->op);
-
-    switch (uuid16) {
-    case BLE_SVC_BAS_CHR_UUID16_BATTERY_LEVEL:
-        if (ctxt->op == BLE_GATT_ACCESS_OP_READ_CHR) {
-            rc = hid_read_buffer(ctxt->om, (int) arg);
-            /* rc = hid_battery_level_get(ctxt->om); */
-            if (rc) {
-                BLE_HID_LOG_WARN("Error reading battery buffer, rc = %d\n", rc);
-                rc = BLE_ATT_ERR_INSUFFICIENT_RES;
-            }
-        } else {
-            rc = BLE_ATT_ERR_UNLIKELY;
-        }
-        break;
-
-    case GATT_UUID_BAT_PRESENT_DESCR:
-        if (ctxt->op == BLE_GATT_ACCESS_OP_READ_DSC) {
-            BLE_HID_LOG_INFO("battery character presentation descriptor read, op: %d\n", ctxt->op);
-            rc = os_mbuf_append(ctxt->om, &battery_level_units,
-                                    sizeof battery_level_units);
-
-            if (rc) {
-                rc = BLE_ATT_ERR_INSUFFICIENT_RES;
-            }
+        default:
+            return BLE_ATT_ERR_WRITE_NOT_PERMITTED;
         }
         break;
 
     default:
-        rc = BLE_ATT_ERR_UNLIKELY;
+        return BLE_ATT_ERR_UNLIKELY;
     }
 
-    return rc;
+    return rc == 0 ? 0 : BLE_ATT_ERR_INSUFFICIENT_RES;
 }
 
-/**
- * Simple read access callback for the device information service
- * characteristic.
- */
-int
-ble_svc_dis_access(uint16_t conn_handle, uint16_t attr_handle,
-                   struct ble_gatt_access_ctxt *ctxt, void *arg)
+static void
+gatt_svr_dis_set(int handle_num, const void *data, uint16_t len)
 {
-    uint16_t uuid = ble_uuid_u16(ctxt->chr->uuid);
-    const char *info = NULL;
-    int rc = 0;
-    int data_len = 0;
-
-    BLE_HID_LOG_INFO("%s: UUID %04X attr %04X arg %d op %d\n",
-            __FUNCTION__, uuid, attr_handle, (int)arg, ctxt->op);
-
-    switch (uuid) {
-    case BLE_SVC_DIS_CHR_UUID16_MODEL_NUMBER:
-        info = hid_dis_data.model_number;
-        if (info == NULL) {
-            info = (BLE_SVC_DIS_MODEL_NUMBER_DEFAULT);
-        }
-        break;
-    case BLE_SVC_DIS_CHR_UUID16_SERIAL_NUMBER:
-        info = hid_dis_data.serial_number;
-        if (info == NULL) {
-            info = (BLE_SVC_DIS_SERIAL_NUMBER_DEFAULT);
-        }
-        break;
-    case BLE_SVC_DIS_CHR_UUID16_FIRMWARE_REVISION:
-        info = hid_dis_data.firmware_revision;
-        if (info == NULL) {
-            info = (BLE_SVC_DIS_FIRMWARE_REVISION_DEFAULT);
-        }
-        break;
-    case BLE_SVC_DIS_CHR_UUID16_HARDWARE_REVISION:
-        info = hid_dis_data.hardware_revision;
-        if (info == NULL) {
-            info = (BLE_SVC_DIS_HARDWARE_REVISION_DEFAULT);
-        }
-        break;
-    case BLE_SVC_DIS_CHR_UUID16_SOFTWARE_REVISION:
-        info = hid_dis_data.software_revision;
-        if (info == NULL) {
-            info = (BLE_SVC_DIS_SOFTWARE_REVISION_DEFAULT);
-        }
-        break;
-    case BLE_SVC_DIS_CHR_UUID16_MANUFACTURER_NAME:
-        info = hid_dis_data.manufacturer_name;
-        if (info == NULL) {
-            info = (BLE_SVC_DIS_MANUFACTURER_NAME_DEFAULT);
-        }
-        break;
-    case BLE_SVC_DIS_CHR_UUID16_SYSTEM_ID:
-        info = hid_dis_data.system_id;
-        if (info == NULL) {
-            info = (BLE_SVC_DIS_SYSTEM_ID_DEFAULT);
-        }
-        break;
-    case BLE_SVC_DIS_CHR_UUID16_PNP_INFO:
-        info = (char *)hid_dis_data.pnp_info;
-        data_len = sizeof(hid_dis_data.pnp_info);
-        if (info == NULL) {
-            info = BLE_SVC_DIS_SYSTEM_ID_DEFAULT;
-        }
-        break;
-    default:
-        rc = BLE_ATT_ERR_UNLIKELY;
-    }
-
-    if (!data_len) {
-        data_len = strlen(info);
-    }
+    gatt_svr_dis_attrs[handle_num].buf = data;
+    gatt_svr_dis_attrs[handle_num].len = len;
+    gatt_svr_dis_attrs[handle_num].handle_num = handle_num;
+}
 
-    if (info != NULL) {
-        rc = os_mbuf_append(ctxt->om, info, data_len);
-        if (rc) {
-            rc = BLE_ATT_ERR_INSUFFICIENT_RES;
-        }
+static void
+gatt_svr_dis_set_str(int handle_num, const char *str, const char *dflt)
+{
+    if (str == NULL) {
+        str = dflt;
     }
+    gatt_svr_dis_set(handle_num, str, strlen(str));
+}
 
-    return rc;
+/* lengths of the DIS values are computed once, not on every read */
+static void
+gatt_svr_dis_init(void)
+{
+    gatt_svr_dis_set_str(HANDLE_DIS_MODEL_NUMBER,
+        hid_dis_data.model_number, BLE_SVC_DIS_MODEL_NUMBER_DEFAULT);
+    gatt_svr_dis_set_str(HANDLE_DIS_SERIAL_NUMBER,
+        hid_dis_data.serial_number, BLE_SVC_DIS_SERIAL_NUMBER_DEFAULT);
+    gatt_svr_dis_set_str(HANDLE_DIS_HARDWARE_REVISION,
+        hid_dis_data.hardware_revision, BLE_SVC_DIS_HARDWARE_REVISION_DEFAULT);
+    gatt_svr_dis_set_str(HANDLE_DIS_FIRMWARE_REVISION,
+        hid_dis_data.firmware_revision, BLE_SVC_DIS_FIRMWARE_REVISION_DEFAULT);
+    gatt_svr_dis_set_str(HANDLE_DIS_SOFWARE_REVISION,
+        hid_dis_data.software_revision, BLE_SVC_DIS_SOFTWARE_REVISION_DEFAULT);
+    gatt_svr_dis_set_str(HANDLE_DIS_MANUFACTURER_NAME,
+        hid_dis_data.manufacturer_name, BLE_SVC_DIS_MANUFACTURER_NAME_DEFAULT);
+    gatt_svr_dis_set_str(HANDLE_DIS_SYSTEM_ID,
+        hid_dis_data.system_id, BLE_SVC_DIS_SYSTEM_ID_DEFAULT);
+    gatt_svr_dis_set(HANDLE_DIS_PNP_INFO,
+        hid_dis_data.pnp_info, sizeof(hid_dis_data.pnp_info));
 }
 
 void
 gatt_svr_register_cb(struct ble_gatt_register_ctxt *ctxt, void *arg)
 {
+    const struct gatt_svr_attr *attr;
     char buf[BLE_UUID_STR_LEN];
 
+    gatt_cache_register(ctxt);
+
     switch (ctxt->op) {
     case BLE_GATT_REGISTER_OP_SVC:
         BLE_HID_LOG_INFO("uuid16 %s handle=%d (%04X)\n",
@@ -360,17 +216,19 @@ gatt_svr_register_cb(struct ble_gatt_register_ctxt *ctxt, void *arg)
         break;
 
     case BLE_GATT_REGISTER_OP_CHR:
-        BLE_HID_LOG_INFO("uuid16 %s arg %d def_handle=%d (%04X) val_handle=%d (%04X)\n",
+        attr = ctxt->chr.chr_def->arg;
+        BLE_HID_LOG_INFO("uuid16 %s handle_num %d def_handle=%d (%04X) val_handle=%d (%04X)\n",
                 ble_uuid_to_str(ctxt->chr.chr_def->uuid, buf),
-                         (int)ctxt->chr.chr_def->arg,
+                attr ? attr->handle_num : -1,
                 ctxt->chr.def_handle, ctxt->chr.def_handle,
                 ctxt->chr.val_handle, ctxt->chr.val_handle);
         break;
 
     case BLE_GATT_REGISTER_OP_DSC:
-        BLE_HID_LOG_INFO("descrip", "uuid16 %s arg %d handle=%d (%04X)\n",
+        attr = ctxt->dsc.dsc_def->arg;
+        BLE_HID_LOG_INFO("descriptor uuid16 %s handle_num %d handle=%d (%04X)\n",
                 ble_uuid_to_str(ctxt->dsc.dsc_def->uuid, buf),
-                         (int)ctxt->dsc.dsc_def->arg,
+                attr ? attr->handle_num : -1,
                 ctxt->dsc.handle, ctxt->dsc.handle);
         break;
     }
@@ -383,6 +241,18 @@ gatt_svr_init(void)
 
     memset(&svc_char_handles, 0, sizeof(svc_char_handles[0]) * HANDLE_HID_COUNT);
 
+    hid_reports_init();
+
+    rc = hid_validate_report_map(hid_report_map, hid_report_map_size);
+    assert(rc == 0);
+
+    gatt_svr_dis_init();
+
+    rc = ble_gatts_count_cfg(gatt_cache_svcs);
+    assert(rc == 0);
+    rc = ble_gatts_add_svcs(gatt_cache_svcs);
+    assert(rc == 0);
+
     rc = ble_gatts_count_cfg(g_gatt_svr_included_services);
     assert(rc == 0);
     rc = ble_gatts_add_svcs(g_gatt_svr_included_services);
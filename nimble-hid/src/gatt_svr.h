@@ -23,7 +23,6 @@
 #include "nimble/ble.h"
 #include "host/ble_hs.h"
 #include "host/ble_uuid.h"
-#include "services/gatt/ble_svc_gatt.h"
 #include "services/gap/ble_svc_gap.h"
 #include "services/bas/ble_svc_bas.h"
 #include "svc_dis.h"
@@ -236,6 +235,30 @@ enum attr_handles {
     HANDLE_HID_COUNT                    /* 21 */
 };
 
+/* Rows of hid_report_ref_data, one per Report Reference descriptor */
+enum {
+    RPT_REF_MOUSE_IN,
+    RPT_REF_KB_IN,
+    RPT_REF_KB_OUT,
+    RPT_REF_CC_IN,
+    RPT_REF_FEATURE,
+    RPT_REF_COUNT
+};
+
+/*
+   Access descriptor carried in .arg of every characteristic and descriptor.
+   The access callback set next to it is the handler, so an access is one
+   indirect call without UUID decoding or table lookups.
+ */
+struct gatt_svr_attr {
+    const void *buf;    /* value served by gatt_svr_attr_read() */
+    uint16_t len;
+    int handle_num;     /* index into svc_char_handles, -1 if none */
+};
+
+#define GATT_SVR_ACCESS(handler, attr) \
+    .access_cb = (handler), .arg = (void *)&(attr)
+
 struct report_reference_table {
     int id;
     uint8_t hidReportRef[HID_REPORT_REF_LEN];
@@ -246,22 +269,21 @@ void gatt_svr_register_cb(struct ble_gatt_register_ctxt *ctxt, void *arg);
 void gatt_svr_init(void);
 
 
-int hid_svr_chr_access(uint16_t conn_handle, uint16_t attr_handle,
-                       struct ble_gatt_access_ctxt *ctxt,
-                       void *arg);
+/* Read of a constant value described by struct gatt_svr_attr */
+int gatt_svr_attr_read(uint16_t conn_handle, uint16_t attr_handle,
+                       struct ble_gatt_access_ctxt *ctxt, void *arg);
+
+int hid_ctrl_point_access(uint16_t conn_handle, uint16_t attr_handle,
+                          struct ble_gatt_access_ctxt *ctxt, void *arg);
+
+int hid_proto_mode_access(uint16_t conn_handle, uint16_t attr_handle,
+                          struct ble_gatt_access_ctxt *ctxt, void *arg);
 
+/* Report access function for all reports and the battery level */
 int ble_svc_report_access(uint16_t conn_handle, uint16_t attr_handle,
                           struct ble_gatt_access_ctxt *ctxt,
                           void *arg);
 
-/* Access function for battery service */
-int ble_svc_battery_access(uint16_t conn_handle, uint16_t attr_handle,
-                           struct ble_gatt_access_ctxt *ctxt, void *arg);
-
-/* Access function for device information service */
-int ble_svc_dis_access(uint16_t conn_handle, uint16_t attr_handle,
-                       struct ble_gatt_access_ctxt *ctxt, void *arg);
-
 /* Globals */
 
 extern const uint8_t hid_report_map[];
@@ -274,10 +296,11 @@ extern const uint8_t hid_info[];
 /* HID External Report Reference Descriptor */
 extern uint16_t hid_ext_report_ref_desc;
 extern uint8_t hid_protocol_mode;
-extern struct report_reference_table hid_report_ref_data[];
+extern struct report_reference_table hid_report_ref_data[RPT_REF_COUNT];
 extern size_t hid_report_ref_data_count;
 extern struct prf_char_pres_fmt battery_level_units;
 extern struct ble_svc_dis_data hid_dis_data;
+extern struct gatt_svr_attr gatt_svr_dis_attrs[];
 #ifdef __cplusplus
 }
 #endif
@@ -19,8 +19,6 @@
 #include "gatt_svr.h"
 
 #define NO_MINKEYSIZE     .min_key_size = DEFAULT_MIN_KEY_SIZE
-#define NO_ARG_MINKEYSIZE .arg = NULL, NO_MINKEYSIZE
-#define NO_ARG_DESCR_MKS  .descriptors = NULL, NO_ARG_MINKEYSIZE
 #define NO_DESCR_MKS      .descriptors = NULL, NO_MINKEYSIZE
 #define MY_NOTIFY_FLAGS (BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_NOTIFY | BLE_GATT_CHR_F_INDICATE)
 #define BCDHID_DATA 0x0111
@@ -179,6 +177,47 @@ const uint8_t hid_report_map[] = {
 };
 size_t hid_report_map_size = sizeof(hid_report_map);
 
+/*
+   Access descriptors passed in .arg of the attributes below.
+   RO_ATTR is a read-only value served as is, HID_ATTR refers to a
+   report or state kept by hid_func.c.
+ */
+#define RO_ATTR(b, l)   { .buf = (b), .len = (l), .handle_num = -1 }
+#define HID_ATTR(h)     { .buf = NULL, .len = 0, .handle_num = (h) }
+#define RPT_REF_ATTR(i) RO_ATTR(hid_report_ref_data[i].hidReportRef, HID_REPORT_REF_LEN)
+
+static const struct gatt_svr_attr battery_level_attr = HID_ATTR(HANDLE_BATTERY_LEVEL);
+static const struct gatt_svr_attr battery_pres_fmt_attr =
+    RO_ATTR(&battery_level_units, sizeof(battery_level_units));
+
+/* DIS values may be overridden in hid_dis_data, filled in by gatt_svr_init() */
+struct gatt_svr_attr gatt_svr_dis_attrs[HANDLE_DIS_PNP_INFO + 1];
+
+static const struct gatt_svr_attr hid_info_attr = RO_ATTR(hid_info, HID_INFORMATION_LEN);
+static const struct gatt_svr_attr ctrl_point_attr = HID_ATTR(HANDLE_HID_CONTROL_POINT);
+static const struct gatt_svr_attr report_map_attr =
+    RO_ATTR(hid_report_map, sizeof(hid_report_map));
+static const struct gatt_svr_attr ext_report_ref_attr =
+    RO_ATTR(&hid_ext_report_ref_desc, sizeof(hid_ext_report_ref_desc));
+static const struct gatt_svr_attr proto_mode_attr =
+    RO_ATTR(&hid_protocol_mode, sizeof(hid_protocol_mode));
+
+static const struct gatt_svr_attr mouse_report_attr = HID_ATTR(HANDLE_HID_MOUSE_REPORT);
+static const struct gatt_svr_attr kb_in_report_attr = HID_ATTR(HANDLE_HID_KB_IN_REPORT);
+static const struct gatt_svr_attr kb_out_report_attr = HID_ATTR(HANDLE_HID_KB_OUT_REPORT);
+static const struct gatt_svr_attr cc_report_attr = HID_ATTR(HANDLE_HID_CC_REPORT);
+static const struct gatt_svr_attr boot_kb_in_report_attr = HID_ATTR(HANDLE_HID_BOOT_KB_IN_REPORT);
+static const struct gatt_svr_attr boot_kb_out_report_attr = HID_ATTR(HANDLE_HID_BOOT_KB_OUT_REPORT);
+static const struct gatt_svr_attr boot_mouse_report_attr = HID_ATTR(HANDLE_HID_BOOT_MOUSE_REPORT);
+static const struct gatt_svr_attr feature_report_attr = HID_ATTR(HANDLE_HID_FEATURE_REPORT);
+
+static const struct gatt_svr_attr mouse_report_ref_attr = RPT_REF_ATTR(RPT_REF_MOUSE_IN);
+static const struct gatt_svr_attr kb_in_report_ref_attr = RPT_REF_ATTR(RPT_REF_KB_IN);
+static const struct gatt_svr_attr kb_out_report_ref_attr = RPT_REF_ATTR(RPT_REF_KB_OUT);
+static const struct gatt_svr_attr cc_report_ref_attr = RPT_REF_ATTR(RPT_REF_CC_IN);
+static const struct gatt_svr_attr feature_report_ref_attr = RPT_REF_ATTR(RPT_REF_FEATURE);
+
+
 const struct ble_gatt_svc_def g_gatt_svr_included_services[] = {
     {
         /*** Battery Service. */
@@ -190,8 +229,7 @@ const struct ble_gatt_svc_def g_gatt_svr_included_services[] = {
                 /*** Battery level characteristic */
                 .uuid = BLE_UUID16_DECLARE(
                         BLE_SVC_BAS_CHR_UUID16_BATTERY_LEVEL),
-                .access_cb = ble_svc_battery_access,
-                .arg = (void *)HANDLE_BATTERY_LEVEL,
+                GATT_SVR_ACCESS(ble_svc_report_access, battery_level_attr),
                 .val_handle = &svc_char_handles[HANDLE_BATTERY_LEVEL],
                 .flags = MY_NOTIFY_FLAGS,
                 NO_MINKEYSIZE,
@@ -201,8 +239,8 @@ const struct ble_gatt_svc_def g_gatt_svr_included_services[] = {
                                     GATT_UUID_BAT_PRESENT_DESCR),
                         .att_flags =
                             BLE_ATT_F_READ | BLE_ATT_F_READ_ENC,
-                        .access_cb = ble_svc_battery_access,
-                        NO_ARG_MINKEYSIZE,
+                        GATT_SVR_ACCESS(gatt_svr_attr_read, battery_pres_fmt_attr),
+                        NO_MINKEYSIZE,
                     },
                     {
                         0,         /* No more descriptors in this
@@ -225,84 +263,92 @@ const struct ble_gatt_svc_def g_gatt_svr_included_services[] = {
                 /*** Characteristic: Model Number String */
                 .uuid = BLE_UUID16_DECLARE(
                         BLE_SVC_DIS_CHR_UUID16_MODEL_NUMBER),
-                .access_cb = ble_svc_dis_access,
+                GATT_SVR_ACCESS(gatt_svr_attr_read,
+                                gatt_svr_dis_attrs[HANDLE_DIS_MODEL_NUMBER]),
                 .val_handle = &svc_char_handles[HANDLE_DIS_MODEL_NUMBER],
                 .flags = BLE_GATT_CHR_F_READ |
                          (BLE_SVC_DIS_MODEL_NUMBER_READ_PERM),
-                NO_ARG_DESCR_MKS,
+                NO_DESCR_MKS,
             },
             {
                 /*** Characteristic: Serial Number String */
                 .uuid = BLE_UUID16_DECLARE(
                         BLE_SVC_DIS_CHR_UUID16_SERIAL_NUMBER),
-                .access_cb = ble_svc_dis_access,
+                GATT_SVR_ACCESS(gatt_svr_attr_read,
+                                gatt_svr_dis_attrs[HANDLE_DIS_SERIAL_NUMBER]),
                 .val_handle = &svc_char_handles[HANDLE_DIS_SERIAL_NUMBER],
                 .flags = BLE_GATT_CHR_F_READ |
                          (BLE_SVC_DIS_SERIAL_NUMBER_READ_PERM),
-                NO_ARG_DESCR_MKS,
+                NO_DESCR_MKS,
             },
             {
                 /*** Characteristic: Hardware Revision String */
                 .uuid = BLE_UUID16_DECLARE(
                         BLE_SVC_DIS_CHR_UUID16_HARDWARE_REVISION),
-                .access_cb = ble_svc_dis_access,
+                GATT_SVR_ACCESS(gatt_svr_attr_read,
+                                gatt_svr_dis_attrs[HANDLE_DIS_HARDWARE_REVISION]),
                 .val_handle =
                     &svc_char_handles[HANDLE_DIS_HARDWARE_REVISION],
                 .flags = BLE_GATT_CHR_F_READ |
                          (BLE_SVC_DIS_HARDWARE_REVISION_READ_PERM),
-                NO_ARG_DESCR_MKS,
+                NO_DESCR_MKS,
             },
             {
                 /*** Characteristic: Firmware Revision String */
                 .uuid = BLE_UUID16_DECLARE(
                         BLE_SVC_DIS_CHR_UUID16_FIRMWARE_REVISION),
-                .access_cb = ble_svc_dis_access,
+                GATT_SVR_ACCESS(gatt_svr_attr_read,
+                                gatt_svr_dis_attrs[HANDLE_DIS_FIRMWARE_REVISION]),
                 .val_handle =
                     &svc_char_handles[HANDLE_DIS_FIRMWARE_REVISION],
                 .flags = BLE_GATT_CHR_F_READ |
                          (BLE_SVC_DIS_FIRMWARE_REVISION_READ_PERM),
-                NO_ARG_DESCR_MKS,
+                NO_DESCR_MKS,
             },
             {
                 /*** Characteristic: Software Revision String */
                 .uuid = BLE_UUID16_DECLARE(
                         BLE_SVC_DIS_CHR_UUID16_SOFTWARE_REVISION),
-                .access_cb = ble_svc_dis_access,
+                GATT_SVR_ACCESS(gatt_svr_attr_read,
+                                gatt_svr_dis_attrs[HANDLE_DIS_SOFWARE_REVISION]),
                 .val_handle =
                     &svc_char_handles[HANDLE_DIS_SOFWARE_REVISION],
                 .flags = BLE_GATT_CHR_F_READ |
                          (BLE_SVC_DIS_SOFTWARE_REVISION_READ_PERM),
-                NO_ARG_DESCR_MKS,
+                NO_DESCR_MKS,
             },
             {
                 /*** Characteristic: Manufacturer Name */
                 .uuid = BLE_UUID16_DECLARE(
                         BLE_SVC_DIS_CHR_UUID16_MANUFACTURER_NAME),
-                .access_cb = ble_svc_dis_access,
+                GATT_SVR_ACCESS(gatt_svr_attr_read,
+                                gatt_svr_dis_attrs[HANDLE_DIS_MANUFACTURER_NAME]),
                 .val_handle =
                     &svc_char_handles[HANDLE_DIS_MANUFACTURER_NAME],
                 .flags = BLE_GATT_CHR_F_READ |
                          (BLE_SVC_DIS_MANUFACTURER_NAME_READ_PERM),
-                NO_ARG_DESCR_MKS,
+                NO_DESCR_MKS,
             },
             {
                 /*** Characteristic: System Id */
                 .uuid = BLE_UUID16_DECLARE(
                         BLE_SVC_DIS_CHR_UUID16_SYSTEM_ID),
-                .access_cb = ble_svc_dis_access,
+                GATT_SVR_ACCESS(gatt_svr_attr_read,
+                                gatt_svr_dis_attrs[HANDLE_DIS_SYSTEM_ID]),
                 .val_handle = &svc_char_handles[HANDLE_DIS_SYSTEM_ID],
                 .flags = BLE_GATT_CHR_F_READ |
                          (BLE_SVC_DIS_SYSTEM_ID_READ_PERM),
-                NO_ARG_DESCR_MKS,
+                NO_DESCR_MKS,
             },
             {
                 /*** Characteristic: System Id */
                 .uuid =
                     BLE_UUID16_DECLARE(BLE_SVC_DIS_CHR_UUID16_PNP_INFO),
-                .access_cb = ble_svc_dis_access,
+                GATT_SVR_ACCESS(gatt_svr_attr_read,
+                                gatt_svr_dis_attrs[HANDLE_DIS_PNP_INFO]),
                 .val_handle = &svc_char_handles[HANDLE_DIS_PNP_INFO],
                 .flags = BLE_GATT_CHR_F_READ,
-                NO_ARG_DESCR_MKS,
+                NO_DESCR_MKS,
             },
             {
                 0, /* No more characteristics in this service */
@@ -330,33 +376,33 @@ const struct ble_gatt_svc_def Gatt_svr_svcs[] = {
             {
                 /*** HID INFO characteristic */
                 .uuid = BLE_UUID16_DECLARE(GATT_UUID_HID_INFORMATION),
-                .access_cb = hid_svr_chr_access,
+                GATT_SVR_ACCESS(gatt_svr_attr_read, hid_info_attr),
                 .val_handle = &svc_char_handles[HANDLE_HID_INFORMATION],
                 .flags = BLE_GATT_CHR_F_READ, /* | BLE_GATT_CHR_F_READ_ENC, */
-                NO_ARG_DESCR_MKS,
+                NO_DESCR_MKS,
             },
             {
                 /*** HID Control Point */
                 .uuid = BLE_UUID16_DECLARE(GATT_UUID_HID_CONTROL_POINT),
-                .access_cb = hid_svr_chr_access,
+                GATT_SVR_ACCESS(hid_ctrl_point_access, ctrl_point_attr),
                 .val_handle = &svc_char_handles[HANDLE_HID_CONTROL_POINT],
                 .flags = BLE_GATT_CHR_F_WRITE, /* | BLE_GATT_CHR_F_WRITE_ENC, */
-                NO_ARG_DESCR_MKS,
+                NO_DESCR_MKS,
             },
             {
                 /*** Report Map */
                 .uuid = BLE_UUID16_DECLARE(GATT_UUID_HID_REPORT_MAP),
-                .access_cb = hid_svr_chr_access,
+                GATT_SVR_ACCESS(gatt_svr_attr_read, report_map_attr),
                 .val_handle = &svc_char_handles[HANDLE_HID_REPORT_MAP],
                 .flags = BLE_GATT_CHR_F_READ,
-                NO_ARG_MINKEYSIZE,
+                NO_MINKEYSIZE,
                 .descriptors = (struct ble_gatt_dsc_def[]) {
                     {
                         /*** External Report Reference Descriptor */
                         .uuid = BLE_UUID16_DECLARE(GATT_UUID_EXT_RPT_REF_DESCR),
                         .att_flags = BLE_ATT_F_READ,
-                        .access_cb = hid_svr_chr_access,
-                        NO_ARG_MINKEYSIZE,
+                        GATT_SVR_ACCESS(gatt_svr_attr_read, ext_report_ref_attr),
+                        NO_MINKEYSIZE,
                     },
                     {
                         0, /* No more descriptors in this characteristic. */
@@ -366,16 +412,15 @@ const struct ble_gatt_svc_def Gatt_svr_svcs[] = {
             {
                 /*** Protocol Mode Characteristic */
                 .uuid = BLE_UUID16_DECLARE(GATT_UUID_HID_PROTO_MODE),
-                .access_cb = hid_svr_chr_access,
+                GATT_SVR_ACCESS(hid_proto_mode_access, proto_mode_attr),
                 .val_handle = &svc_char_handles[HANDLE_HID_PROTO_MODE],
                 .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
-                NO_ARG_DESCR_MKS,
+                NO_DESCR_MKS,
             },
             {
                 /*** Mouse hid report */
                 .uuid = BLE_UUID16_DECLARE(GATT_UUID_HID_REPORT),
-                .access_cb = ble_svc_report_access,
-                .arg = (void *)HANDLE_HID_MOUSE_REPORT,
+                GATT_SVR_ACCESS(ble_svc_report_access, mouse_report_attr),
                 .val_handle = &svc_char_handles[HANDLE_HID_MOUSE_REPORT],
                 .flags = MY_NOTIFY_FLAGS,
                 .min_key_size = DEFAULT_MIN_KEY_SIZE,
@@ -384,8 +429,7 @@ const struct ble_gatt_svc_def Gatt_svr_svcs[] = {
                         /* Report Reference Descriptor */
                         .uuid = BLE_UUID16_DECLARE(GATT_UUID_RPT_REF_DESCR),
                         .att_flags = BLE_ATT_F_READ,
-                        .access_cb = ble_svc_report_access,
-                        .arg = (void *)HANDLE_HID_MOUSE_REPORT,
+                        GATT_SVR_ACCESS(gatt_svr_attr_read, mouse_report_ref_attr),
                         .min_key_size = DEFAULT_MIN_KEY_SIZE,
                     },
                     {
@@ -396,8 +440,7 @@ const struct ble_gatt_svc_def Gatt_svr_svcs[] = {
             {
                 /*** Keyboard hid report */
                 .uuid = BLE_UUID16_DECLARE(GATT_UUID_HID_REPORT),
-                .access_cb = ble_svc_report_access,
-                .arg = (void *)HANDLE_HID_KB_IN_REPORT,
+                GATT_SVR_ACCESS(ble_svc_report_access, kb_in_report_attr),
                 .val_handle = &svc_char_handles[HANDLE_HID_KB_IN_REPORT],
                 .flags = MY_NOTIFY_FLAGS,
                 .min_key_size = DEFAULT_MIN_KEY_SIZE,
@@ -406,8 +449,7 @@ const struct ble_gatt_svc_def Gatt_svr_svcs[] = {
                         /* Report Reference Descriptor */
                         .uuid = BLE_UUID16_DECLARE(GATT_UUID_RPT_REF_DESCR),
                         .att_flags = BLE_ATT_F_READ,
-                        .access_cb = ble_svc_report_access,
-                        .arg = (void *)HANDLE_HID_KB_IN_REPORT,
+                        GATT_SVR_ACCESS(gatt_svr_attr_read, kb_in_report_ref_attr),
                         .min_key_size = DEFAULT_MIN_KEY_SIZE,
                     },
                     {
@@ -418,8 +460,7 @@ const struct ble_gatt_svc_def Gatt_svr_svcs[] = {
             {
                 /*** Keyboard hid out (LED IN/OUT) report */
                 .uuid = BLE_UUID16_DECLARE(GATT_UUID_HID_REPORT),
-                .access_cb = ble_svc_report_access,
-                .arg = (void *)HANDLE_HID_KB_OUT_REPORT,
+                GATT_SVR_ACCESS(ble_svc_report_access, kb_out_report_attr),
                 .val_handle = &svc_char_handles[HANDLE_HID_KB_OUT_REPORT],
                 .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP,
                 .min_key_size = DEFAULT_MIN_KEY_SIZE,
@@ -428,8 +469,7 @@ const struct ble_gatt_svc_def Gatt_svr_svcs[] = {
                         /* Report Reference Descriptor */
                         .uuid = BLE_UUID16_DECLARE(GATT_UUID_RPT_REF_DESCR),
                         .att_flags = BLE_ATT_F_READ,
-                        .access_cb = ble_svc_report_access,
-                        .arg = (void *)HANDLE_HID_KB_OUT_REPORT,
+                        GATT_SVR_ACCESS(gatt_svr_attr_read, kb_out_report_ref_attr),
                         .min_key_size = DEFAULT_MIN_KEY_SIZE,
                     },
                     {
@@ -440,8 +480,7 @@ const struct ble_gatt_svc_def Gatt_svr_svcs[] = {
             {
                 /*** Consumer control hid report */
                 .uuid = BLE_UUID16_DECLARE(GATT_UUID_HID_REPORT),
-                .access_cb = ble_svc_report_access,
-                .arg = (void *)HANDLE_HID_CC_REPORT,
+                GATT_SVR_ACCESS(ble_svc_report_access, cc_report_attr),
                 .val_handle = &svc_char_handles[HANDLE_HID_CC_REPORT],
                 .flags = MY_NOTIFY_FLAGS,
                 .min_key_size = DEFAULT_MIN_KEY_SIZE,
@@ -450,8 +489,7 @@ const struct ble_gatt_svc_def Gatt_svr_svcs[] = {
                         /* Report Reference Descriptor */
                         .uuid = BLE_UUID16_DECLARE(GATT_UUID_RPT_REF_DESCR),
                         .att_flags = BLE_ATT_F_READ,
-                        .access_cb = ble_svc_report_access,
-                        .arg = (void *)HANDLE_HID_CC_REPORT,
+                        GATT_SVR_ACCESS(gatt_svr_attr_read, cc_report_ref_attr),
                         .min_key_size = DEFAULT_MIN_KEY_SIZE,
                     },
                     {
@@ -462,8 +500,7 @@ const struct ble_gatt_svc_def Gatt_svr_svcs[] = {
             {
                 /*** Keyboard input boot hid report */
                 .uuid = BLE_UUID16_DECLARE(GATT_UUID_HID_BT_KB_INPUT),
-                .access_cb = ble_svc_report_access,
-                .arg = (void *)HANDLE_HID_BOOT_KB_IN_REPORT,
+                GATT_SVR_ACCESS(ble_svc_report_access, boot_kb_in_report_attr),
                 .val_handle = &svc_char_handles[HANDLE_HID_BOOT_KB_IN_REPORT],
                 .flags = MY_NOTIFY_FLAGS,
                 NO_DESCR_MKS,
@@ -471,8 +508,7 @@ const struct ble_gatt_svc_def Gatt_svr_svcs[] = {
             {
                 /*** Keyboard output boot hid report */
                 .uuid = BLE_UUID16_DECLARE(GATT_UUID_HID_BT_KB_OUTPUT),
-                .access_cb = ble_svc_report_access,
-                .arg = (void *)HANDLE_HID_BOOT_KB_OUT_REPORT,
+                GATT_SVR_ACCESS(ble_svc_report_access, boot_kb_out_report_attr),
                 .val_handle = &svc_char_handles[HANDLE_HID_BOOT_KB_OUT_REPORT],
                 .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP,
                 NO_DESCR_MKS,
@@ -480,8 +516,7 @@ const struct ble_gatt_svc_def Gatt_svr_svcs[] = {
             {
                 /*** Mouse input boot hid report */
                 .uuid = BLE_UUID16_DECLARE(GATT_UUID_HID_BT_MOUSE_INPUT),
-                .access_cb = ble_svc_report_access,
-                .arg = (void *)HANDLE_HID_BOOT_MOUSE_REPORT,
+                GATT_SVR_ACCESS(ble_svc_report_access, boot_mouse_report_attr),
                 .val_handle = &svc_char_handles[HANDLE_HID_BOOT_MOUSE_REPORT],
                 .flags = MY_NOTIFY_FLAGS,
                 NO_DESCR_MKS,
@@ -489,8 +524,7 @@ const struct ble_gatt_svc_def Gatt_svr_svcs[] = {
             {
                 /*** Feature hid report */
                 .uuid = BLE_UUID16_DECLARE(GATT_UUID_HID_REPORT),
-                .access_cb = ble_svc_report_access,
-                .arg = (void *)HANDLE_HID_FEATURE_REPORT,
+                GATT_SVR_ACCESS(ble_svc_report_access, feature_report_attr),
                 .val_handle = &svc_char_handles[HANDLE_HID_FEATURE_REPORT],
                 .flags = BLE_GATT_CHR_F_READ | BLE_GATT_CHR_F_WRITE,
                 .min_key_size = DEFAULT_MIN_KEY_SIZE,
@@ -499,8 +533,7 @@ const struct ble_gatt_svc_def Gatt_svr_svcs[] = {
                         /* Report Reference Descriptor */
                         .uuid = BLE_UUID16_DECLARE(GATT_UUID_RPT_REF_DESCR),
                         .att_flags = BLE_ATT_F_READ,
-                        .access_cb = ble_svc_report_access,
-                        .arg = (void *)HANDLE_HID_FEATURE_REPORT,
+                        GATT_SVR_ACCESS(gatt_svr_attr_read, feature_report_ref_attr),
                         .min_key_size = DEFAULT_MIN_KEY_SIZE,
                     },
                     {
@@ -532,12 +565,12 @@ uint16_t hid_ext_report_ref_desc = BLE_SVC_BAS_CHR_UUID16_BATTERY_LEVEL;
 uint8_t hid_protocol_mode = HID_PROTOCOL_MODE_REPORT;
 
 /* Report reference table, byte 0 - report id from report map, byte 1 - report type (in,out,feature)*/
-struct report_reference_table hid_report_ref_data[] = {
-    { .id = HANDLE_HID_MOUSE_REPORT,    .hidReportRef = { HID_RPT_ID_MOUSE_IN,  HID_REPORT_TYPE_INPUT   }},
-    { .id = HANDLE_HID_KB_IN_REPORT,    .hidReportRef = { HID_RPT_ID_KB_IN,     HID_REPORT_TYPE_INPUT   }},
-    { .id = HANDLE_HID_KB_OUT_REPORT,   .hidReportRef = { HID_RPT_ID_KB_IN,     HID_REPORT_TYPE_OUTPUT  }},
-    { .id = HANDLE_HID_CC_REPORT,       .hidReportRef = { HID_RPT_ID_CC_IN,     HID_REPORT_TYPE_INPUT   }},
-    { .id = HANDLE_HID_FEATURE_REPORT,  .hidReportRef = { HID_RPT_ID_FEATURE,   HID_REPORT_TYPE_FEATURE }},
+struct report_reference_table hid_report_ref_data[RPT_REF_COUNT] = {
+    [RPT_REF_MOUSE_IN] = { .id = HANDLE_HID_MOUSE_REPORT,   .hidReportRef = { HID_RPT_ID_MOUSE_IN, HID_REPORT_TYPE_INPUT   }},
+    [RPT_REF_KB_IN]    = { .id = HANDLE_HID_KB_IN_REPORT,   .hidReportRef = { HID_RPT_ID_KB_IN,    HID_REPORT_TYPE_INPUT   }},
+    [RPT_REF_KB_OUT]   = { .id = HANDLE_HID_KB_OUT_REPORT,  .hidReportRef = { HID_RPT_ID_KB_IN,    HID_REPORT_TYPE_OUTPUT  }},
+    [RPT_REF_CC_IN]    = { .id = HANDLE_HID_CC_REPORT,      .hidReportRef = { HID_RPT_ID_CC_IN,    HID_REPORT_TYPE_INPUT   }},
+    [RPT_REF_FEATURE]  = { .id = HANDLE_HID_FEATURE_REPORT, .hidReportRef = { HID_RPT_ID_FEATURE,  HID_REPORT_TYPE_FEATURE }},
 };
 size_t hid_report_ref_data_count = sizeof(hid_report_ref_data)/sizeof(hid_report_ref_data[0]);
 
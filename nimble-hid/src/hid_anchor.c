@@ -0,0 +1,163 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "os/mynewt.h"
+#include "defs/error.h"
+#include "nimble-hid/hid_anchor.h"
+
+#if MYNEWT_VAL(BLE_HID_ANCHOR_NRF_RADIO)
+#include "nrf.h"
+#endif
+
+/* An estimate without samples for this many intervals is not used */
+#define ANCHOR_STALE_ITVLS      8
+
+static struct {
+    /* connection interval in cputime ticks, 0 without a link */
+    uint32_t itvl_ticks;
+    /* longest gap between attended events */
+    uint32_t stale_ticks;
+    /* cputime of the last anchor seen */
+    uint32_t last;
+    bool valid;
+} anchor;
+
+#if MYNEWT_VAL(BLE_HID_ANCHOR_NRF_RADIO)
+/*
+   The NimBLE 1.3 host has no connection event callback, so the radio
+   ADDRESS event is routed through PPI to an EGU interrupt.  The first
+   access address of a connection event is the anchor for the peripheral
+   (the central always transmits first).
+ */
+static void
+hid_anchor_egu_irq(void)
+{
+    NRF_EGU0->EVENTS_TRIGGERED[0] = 0;
+    (void)NRF_EGU0->EVENTS_TRIGGERED[0];
+
+    hid_anchor_sample(os_cputime_get32());
+}
+
+static void
+hid_anchor_radio_init(void)
+{
+    NRF_PPI->CH[MYNEWT_VAL(BLE_HID_ANCHOR_PPI_CHAN)].EEP =
+        (uint32_t)&NRF_RADIO->EVENTS_ADDRESS;
+    NRF_PPI->CH[MYNEWT_VAL(BLE_HID_ANCHOR_PPI_CHAN)].TEP =
+        (uint32_t)&NRF_EGU0->TASKS_TRIGGER[0];
+
+    NRF_EGU0->INTENSET = EGU_INTENSET_TRIGGERED0_Msk;
+    /* lowest priority, the sample is only a timestamp */
+    NVIC_SetPriority(SWI0_EGU0_IRQn, (1 << __NVIC_PRIO_BITS) - 1);
+    NVIC_SetVector(SWI0_EGU0_IRQn, (uint32_t)hid_anchor_egu_irq);
+    NVIC_EnableIRQ(SWI0_EGU0_IRQn);
+}
+
+static void
+hid_anchor_radio_enable(bool on)
+{
+    if (on) {
+        NRF_PPI->CHENSET = 1UL << MYNEWT_VAL(BLE_HID_ANCHOR_PPI_CHAN);
+    } else {
+        NRF_PPI->CHENCLR = 1UL << MYNEWT_VAL(BLE_HID_ANCHOR_PPI_CHAN);
+    }
+}
+#else
+#define hid_anchor_radio_init()
+#define hid_anchor_radio_enable(on)
+#endif
+
+void
+hid_anchor_sample(uint32_t ts)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    if (anchor.itvl_ticks &&
+        (!anchor.valid || ts - anchor.last >= anchor.itvl_ticks / 2)) {
+        anchor.last = ts;
+        anchor.valid = true;
+    }
+    OS_EXIT_CRITICAL(sr);
+}
+
+void
+hid_anchor_connected(uint16_t itvl, uint16_t latency)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    anchor.itvl_ticks = os_cputime_usecs_to_ticks((uint32_t)itvl * 1250);
+    anchor.stale_ticks = anchor.itvl_ticks * (latency + 1) * ANCHOR_STALE_ITVLS;
+    /* the anchor moves at the update instant, wait for a new sample */
+    anchor.valid = false;
+    OS_EXIT_CRITICAL(sr);
+
+    hid_anchor_radio_enable(true);
+}
+
+void
+hid_anchor_disconnected(void)
+{
+    os_sr_t sr;
+
+    hid_anchor_radio_enable(false);
+
+    OS_ENTER_CRITICAL(sr);
+    anchor.itvl_ticks = 0;
+    anchor.valid = false;
+    OS_EXIT_CRITICAL(sr);
+}
+
+int
+hid_anchor_next_release(uint32_t now, uint32_t *out_release)
+{
+    uint32_t itvl;
+    uint32_t last;
+    uint32_t lead;
+    uint32_t n;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    itvl = anchor.itvl_ticks;
+    last = anchor.last;
+    if ((int32_t)(now - last) < 0) {
+        /* sampled after 'now' was read */
+        now = last;
+    }
+    if (!anchor.valid || now - last > anchor.stale_ticks) {
+        itvl = 0;
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    if (itvl == 0) {
+        return SYS_ENOENT;
+    }
+
+    /* first anchor last + n * itvl with its release still ahead of now */
+    lead = os_cputime_usecs_to_ticks(MYNEWT_VAL(BLE_HID_ANCHOR_LEAD_US));
+    n = (now + lead - last) / itvl + 1;
+    *out_release = last + n * itvl - lead;
+    return 0;
+}
+
+void
+hid_anchor_init(void)
+{
+    hid_anchor_radio_init();
+}
@@ -0,0 +1,554 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "os/mynewt.h"
+#include "defs/error.h"
+#include "host/ble_hs.h"
+#include "gatt_svr.h"
+#include "hid_codes.h"
+#include "hid_conn_gov.h"
+#include "hid_func.h"
+#include "hid_task.h"
+#include "nimble-hid/hid_bench.h"
+
+#if MYNEWT_VAL(BLE_HID_BENCH)
+
+#if MYNEWT_VAL(SHELL_TASK)
+#include "console/console.h"
+#include "shell/shell.h"
+#endif
+
+#define BENCH_DFLT_ITERS        1000
+/* time allowed for the last replayed reports to reach the controller */
+#define BENCH_REPLAY_DRAIN_MS   200
+#define BENCH_REPLAY_LAT_SLOTS  16
+
+static const uint16_t bench_replay_rates[] = { 10, 100, 1000 };
+#define BENCH_REPLAY_RATES      (sizeof(bench_replay_rates) / sizeof(bench_replay_rates[0]))
+static const char bench_replay_text[] = "the quick brown fox jumps over the lazy dog 1234567890";
+#define BENCH_REPLAY_KEYS       (sizeof(bench_replay_text) - 1)
+
+static SLIST_HEAD(, hid_bench_op) bench_ops = SLIST_HEAD_INITIALIZER(bench_ops);
+
+/* JSON output, see hid_bench_set_output() */
+#if MYNEWT_VAL(SHELL_TASK)
+static int (*bench_out)(const char *fmt, ...) = console_printf;
+#else
+static int (*bench_out)(const char *fmt, ...);
+#endif
+#define BENCH_OUT(...)  do { if (bench_out) bench_out(__VA_ARGS__); } while (0)
+
+/* called in the HID task once the current run printed its results */
+static void (*bench_done)(void);
+static bool bench_run_pending;
+
+static uint32_t bench_iters;
+static volatile uintptr_t bench_sink;
+
+static bool bench_replay_running;
+static int bench_replay_rate;
+
+/* one replay rate */
+static struct {
+    /* press and release events so far */
+    uint32_t events;
+    uint32_t start;
+    uint32_t period;
+    uint32_t cost_sum;
+    uint32_t cost_max;
+    /* send times of reports waiting for NOTIFY_TX */
+    uint32_t sent_ts[BENCH_REPLAY_LAT_SLOTS];
+    uint32_t sent_head;
+    uint32_t sent_tail;
+    uint32_t delivered;
+    uint32_t dropped;
+    uint32_t lat_sum;
+    uint32_t lat_max;
+} bench_replay;
+
+static struct hal_timer bench_replay_timer;
+
+static bool bench_send_running;
+static int bench_send_method;
+static int bench_send_saved_method;
+
+/* one send method */
+static struct {
+    uint32_t count;
+    uint32_t sent;
+    uint32_t delivered;
+    uint32_t start;
+    bool wait_ack;
+} bench_send;
+
+static void bench_run(struct os_event *ev);
+static void bench_replay_step(struct os_event *ev);
+static void bench_send_step(struct os_event *ev);
+
+static struct os_event bench_run_ev = {
+    .ev_cb = bench_run,
+};
+
+static struct os_event bench_replay_ev = {
+    .ev_cb = bench_replay_step,
+};
+
+static struct os_event bench_send_ev = {
+    .ev_cb = bench_send_step,
+};
+
+static uint8_t
+bench_usage(char c)
+{
+    if (c >= 'a' && c <= 'z') {
+        return HID_KEY_A + c - 'a';
+    }
+    if (c >= '1' && c <= '9') {
+        return HID_KEY_1 + c - '1';
+    }
+    if (c == '0') {
+        return HID_KEY_0;
+    }
+    return HID_KEY_SPACEBAR;
+}
+
+static uint32_t
+bench_ns(uint32_t ticks, uint32_t n)
+{
+    return (uint32_t)((uint64_t)os_cputime_ticks_to_usecs(ticks) * 1000 / n);
+}
+
+static void
+bench_print(const char *name, uint32_t ticks, bool first)
+{
+    BENCH_OUT("%s{\"op\":\"%s\",\"n\":%lu,\"ns_op\":%lu}",
+              first ? "" : ",", name, (unsigned long)bench_iters,
+              (unsigned long)bench_ns(ticks, bench_iters));
+}
+
+static void
+bench_op_cc_build(uint32_t i, void *arg)
+{
+    uint8_t buf[HIDD_LE_REPORT_CC_SIZE] = { 0 };
+
+    hid_cc_build_report(buf, HID_CONSUMER_VOLUME_UP, i & 1);
+    bench_sink += buf[0];
+}
+
+static void
+bench_op_report_find(uint32_t i, void *arg)
+{
+    bench_sink += (uintptr_t)hid_report_find(HANDLE_HID_KB_IN_REPORT);
+}
+
+static struct hid_bench_op bench_op_builtin[] = {
+    { .name = "cc_build_report", .fn = bench_op_cc_build },
+    { .name = "report_find", .fn = bench_op_report_find },
+};
+
+static uint32_t
+bench_time_op(struct hid_bench_op *op)
+{
+    uint32_t start;
+    uint32_t i;
+
+    start = os_cputime_get32();
+    for (i = 0; i < bench_iters; ++i) {
+        op->fn(i, op->arg);
+    }
+    return os_cputime_get32() - start;
+}
+
+/*
+   Press and release alternate so the report never runs out of key
+   slots, each call is timed on its own and the cputime ticks summed.
+ */
+static void
+bench_run(struct os_event *ev)
+{
+    struct hid_bench_op *op;
+    uint32_t press = 0;
+    uint32_t release = 0;
+    uint32_t t0, t1, t2;
+    uint8_t key;
+    uint32_t i;
+
+    hid_send_dry_set(true);
+
+    for (i = 0; i < bench_iters; ++i) {
+        key = bench_usage(bench_replay_text[i % BENCH_REPLAY_KEYS]);
+        t0 = os_cputime_get32();
+        hid_keyboard_change_key(key, true);
+        t1 = os_cputime_get32();
+        hid_keyboard_change_key(key, false);
+        t2 = os_cputime_get32();
+        press += t1 - t0;
+        release += t2 - t1;
+    }
+
+    BENCH_OUT("{\"suite\":\"nimble-hid\",\"results\":[");
+    bench_print("kb_press", press, true);
+    bench_print("kb_release", release, false);
+    SLIST_FOREACH(op, &bench_ops, next) {
+        bench_print(op->name, bench_time_op(op), false);
+    }
+    BENCH_OUT("]}\n");
+
+    hid_send_dry_set(false);
+    bench_run_pending = false;
+    if (bench_done) {
+        bench_done();
+    }
+}
+
+static void
+bench_replay_timer_cb(void *arg)
+{
+    os_eventq_put(hid_evq_get(), &bench_replay_ev);
+}
+
+static void
+bench_replay_rate_start(void)
+{
+    uint16_t rate = bench_replay_rates[bench_replay_rate];
+
+    memset(&bench_replay, 0, sizeof(bench_replay));
+    /* a key is a press and a release */
+    bench_replay.period = os_cputime_usecs_to_ticks(1000000 / (2 * rate));
+    bench_replay.start = os_cputime_get32();
+    os_cputime_timer_start(&bench_replay_timer, bench_replay.start);
+}
+
+static void
+bench_replay_rate_print(void)
+{
+    uint32_t keys = bench_replay.events / 2;
+
+    BENCH_OUT("%s{\"op\":\"replay\",\"keys_s\":%u,\"keys\":%lu,"
+              "\"ns_key_avg\":%lu,\"ns_key_max\":%lu,"
+              "\"delivered\":%lu,\"dropped\":%lu",
+              bench_replay_rate ? "," : "",
+              bench_replay_rates[bench_replay_rate],
+              (unsigned long)keys,
+              (unsigned long)bench_ns(bench_replay.cost_sum, keys),
+              (unsigned long)bench_ns(bench_replay.cost_max, 1),
+              (unsigned long)bench_replay.delivered,
+              (unsigned long)bench_replay.dropped);
+    if (bench_replay.delivered) {
+        BENCH_OUT(",\"lat_us_avg\":%lu,\"lat_us_max\":%lu",
+                  (unsigned long)os_cputime_ticks_to_usecs(
+                      bench_replay.lat_sum / bench_replay.delivered),
+                  (unsigned long)os_cputime_ticks_to_usecs(
+                      bench_replay.lat_max));
+    }
+    BENCH_OUT("}");
+}
+
+static void
+bench_replay_step(struct os_event *ev)
+{
+    uint32_t t0;
+    uint32_t cost;
+    uint8_t key;
+    os_sr_t sr;
+
+    if (bench_replay.events == 2 * BENCH_REPLAY_KEYS) {
+        /* drained */
+        bench_replay_rate_print();
+        if (++bench_replay_rate < BENCH_REPLAY_RATES) {
+            bench_replay_rate_start();
+        } else {
+            BENCH_OUT("]}\n");
+            bench_replay_running = false;
+            if (bench_done) {
+                bench_done();
+            }
+        }
+        return;
+    }
+
+    key = bench_usage(bench_replay_text[bench_replay.events / 2]);
+    OS_ENTER_CRITICAL(sr);
+    if (bench_replay.sent_head - bench_replay.sent_tail <
+        BENCH_REPLAY_LAT_SLOTS) {
+        bench_replay.sent_ts[bench_replay.sent_head++ %
+                             BENCH_REPLAY_LAT_SLOTS] = os_cputime_get32();
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    t0 = os_cputime_get32();
+    hid_keyboard_change_key(key, !(bench_replay.events & 1));
+    cost = os_cputime_get32() - t0;
+
+    bench_replay.cost_sum += cost;
+    if (cost > bench_replay.cost_max) {
+        bench_replay.cost_max = cost;
+    }
+
+    if (++bench_replay.events == 2 * BENCH_REPLAY_KEYS) {
+        os_cputime_timer_relative(&bench_replay_timer,
+                                  BENCH_REPLAY_DRAIN_MS * 1000);
+    } else {
+        /* on the grid from the start, a late event does not shift the rest */
+        os_cputime_timer_start(&bench_replay_timer, bench_replay.start +
+                               bench_replay.events * bench_replay.period);
+    }
+}
+
+static void
+bench_send_method_start(void)
+{
+    uint32_t count = bench_send.count;
+
+    memset(&bench_send, 0, sizeof(bench_send));
+    bench_send.count = count;
+    hid_send_method_set(bench_send_method);
+    hid_conn_gov_activity();
+    bench_send.start = os_cputime_get32();
+    os_eventq_put(hid_evq_get(), &bench_send_ev);
+}
+
+static void
+bench_send_finish(int rc)
+{
+    BENCH_OUT("]}\n");
+    if (rc != 0) {
+        BENCH_OUT("hidbench: send failed; rc=%d\n", rc);
+    }
+    hid_send_method_set(bench_send_saved_method);
+    bench_send_running = false;
+    if (bench_done) {
+        bench_done();
+    }
+}
+
+/*
+   Sends the current keyboard report as fast as the stack takes it.  A
+   report counts once its notification is queued to the controller or
+   its indication is confirmed.
+ */
+static void
+bench_send_step(struct os_event *ev)
+{
+    uint32_t usecs;
+    bool indicate;
+    int rc;
+
+    if (bench_send.delivered >= bench_send.count) {
+        usecs = os_cputime_ticks_to_usecs(os_cputime_get32() - bench_send.start);
+        BENCH_OUT("%s{\"op\":\"send_%s\",\"n\":%lu,\"us\":%lu,\"reports_s\":%lu}",
+                  bench_send_method ? "," : "",
+                  hid_send_method_names[bench_send_method],
+                  (unsigned long)bench_send.count, (unsigned long)usecs,
+                  usecs ? (unsigned long)((uint64_t)bench_send.count * 1000000 / usecs) : 0);
+        if (++bench_send_method < HID_SEND_METHOD_CNT) {
+            bench_send_method_start();
+        } else {
+            bench_send_finish(0);
+        }
+        return;
+    }
+
+    while (bench_send.sent < bench_send.count && !bench_send.wait_ack) {
+        rc = hid_kb_report_tx(&indicate);
+        if (rc == BLE_HS_ENOMEM) {
+            /* continued on the next NOTIFY_TX */
+            return;
+        }
+        if (rc != 0) {
+            bench_send_finish(rc);
+            return;
+        }
+        bench_send.sent++;
+        bench_send.wait_ack = indicate;
+    }
+}
+
+static void
+bench_send_tx_done(bool ok)
+{
+    if (ok) {
+        bench_send.delivered++;
+    } else if (hid_send_method_get() == HID_SEND_METHOD_ALL) {
+        /* chr_updated() does not return the error, send it again */
+        bench_send.sent--;
+    }
+    /* an indication blocks the next report until it is confirmed */
+    bench_send.wait_ack = false;
+
+    os_eventq_put(hid_evq_get(), &bench_send_ev);
+}
+
+void
+hid_bench_kb_tx_done(bool ok)
+{
+    uint32_t lat;
+    os_sr_t sr;
+
+    if (bench_send_running) {
+        bench_send_tx_done(ok);
+        return;
+    }
+
+    OS_ENTER_CRITICAL(sr);
+    if (!bench_replay_running ||
+        bench_replay.sent_tail == bench_replay.sent_head) {
+        OS_EXIT_CRITICAL(sr);
+        return;
+    }
+    lat = os_cputime_get32() -
+          bench_replay.sent_ts[bench_replay.sent_tail++ %
+                               BENCH_REPLAY_LAT_SLOTS];
+    OS_EXIT_CRITICAL(sr);
+
+    /* NOTIFY_TX runs in the host task, the counters are only read once
+     * the rate has drained */
+    if (!ok) {
+        bench_replay.dropped++;
+        return;
+    }
+
+    bench_replay.delivered++;
+    bench_replay.lat_sum += lat;
+    if (lat > bench_replay.lat_max) {
+        bench_replay.lat_max = lat;
+    }
+}
+
+void
+hid_bench_op_register(struct hid_bench_op *op)
+{
+    SLIST_INSERT_HEAD(&bench_ops, op, next);
+}
+
+static bool
+bench_busy(void)
+{
+    return bench_run_pending || bench_replay_running || bench_send_running;
+}
+
+int
+hid_bench_run(uint32_t iters, void (*done)(void))
+{
+    if (bench_busy()) {
+        return SYS_EBUSY;
+    }
+    if (iters == 0) {
+        return SYS_EINVAL;
+    }
+
+    bench_iters = iters;
+    bench_done = done;
+    bench_run_pending = true;
+    os_eventq_put(hid_evq_get(), &bench_run_ev);
+    return 0;
+}
+
+int
+hid_bench_replay(void (*done)(void))
+{
+    if (bench_busy()) {
+        return SYS_EBUSY;
+    }
+
+    bench_done = done;
+    bench_replay_running = true;
+    bench_replay_rate = 0;
+    BENCH_OUT("{\"suite\":\"nimble-hid\",\"results\":[");
+    bench_replay_rate_start();
+    return 0;
+}
+
+int
+hid_bench_send(uint32_t count, void (*done)(void))
+{
+    if (bench_busy()) {
+        return SYS_EBUSY;
+    }
+    if (count == 0) {
+        return SYS_EINVAL;
+    }
+
+    bench_done = done;
+    bench_send.count = count;
+    bench_send_running = true;
+    bench_send_method = 0;
+    bench_send_saved_method = hid_send_method_get();
+    BENCH_OUT("{\"suite\":\"nimble-hid\",\"results\":[");
+    bench_send_method_start();
+    return 0;
+}
+
+void
+hid_bench_set_output(int (*out)(const char *fmt, ...))
+{
+    bench_out = out;
+}
+
+#if MYNEWT_VAL(SHELL_TASK)
+static int
+hid_bench_cli_cmd(int argc, char **argv)
+{
+    int rc;
+
+    if (argc == 3 && !strcmp(argv[1], "send")) {
+        rc = hid_bench_send(strtoul(argv[2], NULL, 0), NULL);
+    } else if (argc == 2 && !strcmp(argv[1], "replay")) {
+        rc = hid_bench_replay(NULL);
+    } else {
+        rc = hid_bench_run(argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_DFLT_ITERS,
+                           NULL);
+    }
+    if (rc == SYS_EINVAL) {
+        console_printf("usage: hidbench [<n>|replay|send <n>]\n");
+    }
+    return rc;
+}
+
+static struct shell_cmd hid_bench_cli = {
+    .sc_cmd = "hidbench",
+    .sc_cmd_func = hid_bench_cli_cmd,
+};
+#endif
+
+void
+hid_bench_init(void)
+{
+#if MYNEWT_VAL(SHELL_TASK)
+    int rc;
+#endif
+    int i;
+
+    os_cputime_timer_init(&bench_replay_timer, bench_replay_timer_cb, NULL);
+
+    /* ops print newest first, applications register theirs after this */
+    for (i = sizeof(bench_op_builtin) / sizeof(bench_op_builtin[0]) - 1;
+         i >= 0; --i) {
+        hid_bench_op_register(&bench_op_builtin[i]);
+    }
+
+#if MYNEWT_VAL(SHELL_TASK)
+    rc = shell_cmd_register(&hid_bench_cli);
+    SYSINIT_PANIC_ASSERT(rc == 0);
+#endif
+}
+
+#endif
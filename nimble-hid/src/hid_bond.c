@@ -0,0 +1,399 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "os/mynewt.h"
+#include "hal/hal_system.h"
+#include "config/config.h"
+#include "defs/error.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+#include "nimble-hid/nimble-hid.h"
+#include "gatt_svr.h"
+#include "hid_bond.h"
+
+#define HID_BOND_SLOTS  MYNEWT_VAL(BLE_HID_BOND_SLOTS)
+
+#if HID_BOND_SLOTS > MYNEWT_VAL(BLE_STORE_MAX_BONDS)
+#error "BLE_HID_BOND_SLOTS can not exceed BLE_STORE_MAX_BONDS"
+#endif
+
+struct hid_bond_slot {
+    ble_addr_t peer;
+    uint8_t valid;
+};
+
+static struct hid_bond_slot hid_bond_slots[HID_BOND_SLOTS];
+static struct hid_bond_gatt hid_bond_gatts[HID_BOND_SLOTS];
+static uint8_t hid_bond_active;
+/* switched to, not persisted yet, see hid_bond_save_active() */
+static bool hid_bond_active_dirty;
+/* taken slot a new host may pair into, see hid_bond_allow_pairing() */
+static int8_t hid_bond_pair_slot = -1;
+
+#if MYNEWT_VAL(BLE_HID_RETAIN)
+#define HID_BOND_RETAIN_MAGIC   0x48494452  /* "HIDR" */
+
+/*
+   Active slot over System OFF.  Not zeroed at startup and only trusted
+   once, after a System OFF wake; the config store loads the same slot
+   over it later.
+ */
+static struct {
+    uint32_t magic;
+    uint8_t active;
+    struct hid_bond_slot slot;
+} hid_bond_retained __attribute__((section(".bss.core.nz")));
+/* hid_bond_seed_wake() stands in for the System OFF reset cause */
+static bool hid_bond_wake_seeded;
+#endif
+
+static int hid_bond_conf_set(int argc, char **argv, char *val);
+static int hid_bond_conf_export(void (*func)(char *name, char *val),
+                                conf_export_tgt_t tgt);
+
+static struct conf_handler hid_bond_conf_handler = {
+    .ch_name = "hid",
+    .ch_get = NULL,
+    .ch_set = hid_bond_conf_set,
+    .ch_commit = NULL,
+    .ch_export = hid_bond_conf_export,
+};
+
+/* "hid/slot<n>" holds the slot, "hid/gatt<n>" the GATT caching state of
+   its host, "hid/active" the active slot number */
+static int
+hid_bond_conf_set(int argc, char **argv, char *val)
+{
+    int slot;
+    int len;
+
+    int rc;
+
+    if (argc != 1) {
+        return SYS_ENOENT;
+    }
+
+    if (!strcmp(argv[0], "active")) {
+        rc = conf_value_from_str(val, CONF_INT8, &hid_bond_active,
+                                 sizeof(hid_bond_active));
+        if (hid_bond_active >= HID_BOND_SLOTS) {
+            /* the number of slots was reduced */
+            hid_bond_active = 0;
+        }
+        return rc;
+    }
+
+    if (sscanf(argv[0], "gatt%d", &slot) == 1 && slot >= 0 && slot < HID_BOND_SLOTS) {
+        len = sizeof(hid_bond_gatts[slot]);
+        return conf_bytes_from_str(val, &hid_bond_gatts[slot], &len);
+    }
+
+    if (sscanf(argv[0], "slot%d", &slot) != 1 || slot < 0 || slot >= HID_BOND_SLOTS) {
+        return SYS_ENOENT;
+    }
+
+    len = sizeof(hid_bond_slots[slot]);
+    return conf_bytes_from_str(val, &hid_bond_slots[slot], &len);
+}
+
+static void
+hid_bond_conf_name(int slot, char *name, size_t size)
+{
+    snprintf(name, size, "hid/slot%d", slot);
+}
+
+static void
+hid_bond_gatt_conf_name(int slot, char *name, size_t size)
+{
+    snprintf(name, size, "hid/gatt%d", slot);
+}
+
+static int
+hid_bond_conf_export(void (*func)(char *name, char *val), conf_export_tgt_t tgt)
+{
+    char buf[CONF_STR_FROM_BYTES_LEN(sizeof(struct hid_bond_gatt)) + 1];
+    char name[16];
+
+    for (int i = 0; i < HID_BOND_SLOTS; ++i) {
+        hid_bond_conf_name(i, name, sizeof(name));
+        func(name, conf_str_from_bytes(&hid_bond_slots[i], sizeof(hid_bond_slots[i]),
+                                       buf, sizeof(buf)));
+        hid_bond_gatt_conf_name(i, name, sizeof(name));
+        func(name, conf_str_from_bytes(&hid_bond_gatts[i], sizeof(hid_bond_gatts[i]),
+                                       buf, sizeof(buf)));
+    }
+    func("hid/active", conf_str_from_value(CONF_INT8, &hid_bond_active, buf, sizeof(buf)));
+
+    return 0;
+}
+
+static void
+hid_bond_save_slot(int slot)
+{
+    char buf[CONF_STR_FROM_BYTES_LEN(sizeof(struct hid_bond_slot)) + 1];
+    char name[16];
+    int rc;
+
+    hid_bond_conf_name(slot, name, sizeof(name));
+    rc = conf_save_one(name, conf_str_from_bytes(&hid_bond_slots[slot],
+                                                 sizeof(hid_bond_slots[slot]),
+                                                 buf, sizeof(buf)));
+    if (rc != 0) {
+        BLE_HID_LOG_ERROR("saving host slot %d failed; rc=%d\n", slot, rc);
+    }
+}
+
+static void
+hid_bond_save_gatt(int slot)
+{
+    char buf[CONF_STR_FROM_BYTES_LEN(sizeof(struct hid_bond_gatt)) + 1];
+    char name[16];
+    int rc;
+
+    hid_bond_gatt_conf_name(slot, name, sizeof(name));
+    rc = conf_save_one(name, conf_str_from_bytes(&hid_bond_gatts[slot],
+                                                 sizeof(hid_bond_gatts[slot]),
+                                                 buf, sizeof(buf)));
+    if (rc != 0) {
+        BLE_HID_LOG_ERROR("saving gatt state of slot %d failed; rc=%d\n", slot, rc);
+    }
+}
+
+int
+hid_bond_find(const ble_addr_t *peer)
+{
+    for (int i = 0; i < HID_BOND_SLOTS; ++i) {
+        if (hid_bond_slots[i].valid && !ble_addr_cmp(&hid_bond_slots[i].peer, peer)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int
+hid_bond_active_slot(void)
+{
+    return hid_bond_active;
+}
+
+int
+hid_bond_set_active(int slot)
+{
+    if (slot < 0 || slot >= HID_BOND_SLOTS) {
+        return SYS_EINVAL;
+    }
+    if (slot == hid_bond_active) {
+        return 0;
+    }
+
+    hid_bond_active = slot;
+    hid_bond_pair_slot = -1;
+    hid_bond_active_dirty = true;
+    return 0;
+}
+
+void
+hid_bond_save_active(void)
+{
+    char buf[8];
+    int rc;
+
+    if (!hid_bond_active_dirty) {
+        return;
+    }
+    hid_bond_active_dirty = false;
+
+    rc = conf_save_one("hid/active",
+                       conf_str_from_value(CONF_INT8, &hid_bond_active, buf, sizeof(buf)));
+    if (rc != 0) {
+        BLE_HID_LOG_ERROR("saving active slot failed; rc=%d\n", rc);
+    }
+}
+
+const ble_addr_t *
+hid_bond_active_peer(void)
+{
+    if (hid_bond_active >= HID_BOND_SLOTS || !hid_bond_slots[hid_bond_active].valid) {
+        return NULL;
+    }
+    return &hid_bond_slots[hid_bond_active].peer;
+}
+
+int
+hid_bond_link_encrypted(const ble_addr_t *peer)
+{
+    struct hid_bond_slot *active = &hid_bond_slots[hid_bond_active];
+    int slot = hid_bond_find(peer);
+
+    if (slot == hid_bond_active) {
+        return 0;
+    }
+    if (slot >= 0) {
+        BLE_HID_LOG_INFO("host of slot %d connected while slot %d is active\n",
+                         slot, hid_bond_active);
+        return SYS_EPERM;
+    }
+
+    if (active->valid && hid_bond_pair_slot != hid_bond_active) {
+        /* the slot's host stays, forget the bond just made */
+        BLE_HID_LOG_INFO("new host rejected, slot %d is taken\n", hid_bond_active);
+        ble_store_util_delete_peer(peer);
+        return SYS_EPERM;
+    }
+
+    /* a newly paired host takes the empty or selected active slot */
+    if (active->valid) {
+        BLE_HID_LOG_INFO("host slot %d paired with a new host\n", hid_bond_active);
+        ble_store_util_delete_peer(&active->peer);
+    }
+    active->peer = *peer;
+    active->valid = 1;
+    hid_bond_pair_slot = -1;
+    hid_bond_save_slot(hid_bond_active);
+    memset(&hid_bond_gatts[hid_bond_active], 0, sizeof(hid_bond_gatts[0]));
+    hid_bond_save_gatt(hid_bond_active);
+
+    return 0;
+}
+
+void
+hid_bond_allow_pairing(int slot)
+{
+    if (slot == hid_bond_active) {
+        hid_bond_pair_slot = slot;
+    }
+}
+
+int
+hid_bond_clear(int slot)
+{
+    if (slot < 0 || slot >= HID_BOND_SLOTS) {
+        return SYS_EINVAL;
+    }
+    if (!hid_bond_slots[slot].valid) {
+        return 0;
+    }
+
+    ble_store_util_delete_peer(&hid_bond_slots[slot].peer);
+    memset(&hid_bond_slots[slot], 0, sizeof(hid_bond_slots[slot]));
+    hid_bond_save_slot(slot);
+    memset(&hid_bond_gatts[slot], 0, sizeof(hid_bond_gatts[slot]));
+    hid_bond_save_gatt(slot);
+
+    return 0;
+}
+
+int
+hid_bond_seed(int slot, uint8_t addr_type, const uint8_t *addr)
+{
+    if (slot < 0 || slot >= HID_BOND_SLOTS) {
+        return SYS_EINVAL;
+    }
+
+    hid_bond_slots[slot].peer.type = addr_type;
+    memcpy(hid_bond_slots[slot].peer.val, addr, sizeof(hid_bond_slots[slot].peer.val));
+    hid_bond_slots[slot].valid = 1;
+    memset(&hid_bond_gatts[slot], 0, sizeof(hid_bond_gatts[slot]));
+    return 0;
+}
+
+const struct hid_bond_gatt *
+hid_bond_gatt_get(int slot)
+{
+    if (slot < 0 || slot >= HID_BOND_SLOTS || !hid_bond_slots[slot].valid) {
+        return NULL;
+    }
+    return &hid_bond_gatts[slot];
+}
+
+int
+hid_bond_gatt_set(int slot, const struct hid_bond_gatt *gatt)
+{
+    if (slot < 0 || slot >= HID_BOND_SLOTS || !hid_bond_slots[slot].valid) {
+        return SYS_EINVAL;
+    }
+    if (!memcmp(&hid_bond_gatts[slot], gatt, sizeof(*gatt))) {
+        return 0;
+    }
+
+    hid_bond_gatts[slot] = *gatt;
+    hid_bond_save_gatt(slot);
+    return 0;
+}
+
+#if MYNEWT_VAL(BLE_HID_RETAIN)
+const void *
+hid_bond_retain(size_t *len)
+{
+    hid_bond_retained.active = hid_bond_active;
+    hid_bond_retained.slot = hid_bond_slots[hid_bond_active];
+    hid_bond_retained.magic = HID_BOND_RETAIN_MAGIC;
+
+    *len = sizeof(hid_bond_retained);
+    return &hid_bond_retained;
+}
+
+bool
+hid_bond_restore(void)
+{
+    bool restored = false;
+
+    if ((hal_reset_cause() == HAL_RESET_SYS_OFF_INT || hid_bond_wake_seeded) &&
+        hid_bond_retained.magic == HID_BOND_RETAIN_MAGIC &&
+        hid_bond_retained.active < HID_BOND_SLOTS &&
+        hid_bond_retained.slot.valid) {
+        hid_bond_active = hid_bond_retained.active;
+        hid_bond_slots[hid_bond_active] = hid_bond_retained.slot;
+        restored = true;
+    }
+    hid_bond_retained.magic = 0;
+    hid_bond_wake_seeded = false;
+
+    return restored;
+}
+
+int
+hid_bond_seed_wake(int slot, uint8_t addr_type, const uint8_t *addr)
+{
+    if (slot < 0 || slot >= HID_BOND_SLOTS) {
+        return SYS_EINVAL;
+    }
+
+    memset(&hid_bond_retained, 0, sizeof(hid_bond_retained));
+    hid_bond_retained.active = slot;
+    hid_bond_retained.slot.peer.type = addr_type;
+    memcpy(hid_bond_retained.slot.peer.val, addr,
+           sizeof(hid_bond_retained.slot.peer.val));
+    hid_bond_retained.slot.valid = 1;
+    hid_bond_retained.magic = HID_BOND_RETAIN_MAGIC;
+    hid_bond_wake_seeded = true;
+    return 0;
+}
+#endif
+
+void
+hid_bond_init(void)
+{
+    int rc;
+
+    rc = conf_register(&hid_bond_conf_handler);
+    SYSINIT_PANIC_ASSERT(rc == 0);
+}
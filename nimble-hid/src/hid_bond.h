@@ -0,0 +1,98 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_HID_BOND_
+#define H_HID_BOND_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "nimble/ble.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Host slots.  Each slot holds the identity address of one bonded host,
+   the keys stay in the NimBLE store.  The slot table and the active slot
+   are kept in RAM and persisted with sys/config ("hid/...").
+ */
+
+void hid_bond_init(void);
+
+int hid_bond_active_slot(void);
+
+/*
+   Switches the active slot in RAM.  The flash write is left to
+   hid_bond_save_active(), called once advertising for the new slot's
+   host is running, so it does not delay the switch.
+ */
+int hid_bond_set_active(int slot);
+void hid_bond_save_active(void);
+
+/* identity address of the active slot's host, NULL if the slot is empty */
+const ble_addr_t *hid_bond_active_peer(void);
+
+/* slot whose host is 'peer', -1 if none */
+int hid_bond_find(const ble_addr_t *peer);
+
+/*
+   A bonded link to 'peer' got encrypted.  Returns 0 if the host may stay
+   connected: it is the active slot's host, or a new host that takes the
+   active slot because it is empty or selected with
+   hid_bond_allow_pairing().  Non-zero if it belongs to another slot, or
+   is a new host and the slot is taken; its new bond is deleted then.
+ */
+int hid_bond_link_encrypted(const ble_addr_t *peer);
+
+/*
+   Lets the next new host pair into the active slot 'slot' although it is
+   taken, replacing its host.  Cleared by a switch to another slot.
+ */
+void hid_bond_allow_pairing(int slot);
+
+/* forget the host of a slot and delete its bond */
+int hid_bond_clear(int slot);
+
+/* GATT caching state of a slot's host, kept for gatt_cache.c */
+struct hid_bond_gatt {
+    uint8_t features;       /* Client Supported Features */
+    uint8_t db_hash[16];    /* database hash the host has seen, zero
+                               until its first encrypted link */
+};
+
+/* NULL if the slot is empty */
+const struct hid_bond_gatt *hid_bond_gatt_get(int slot);
+/* persists the state if it changed */
+int hid_bond_gatt_set(int slot, const struct hid_bond_gatt *gatt);
+
+/* BLE_HID_RETAIN: copies the active slot to retained RAM before System
+   OFF, returns the block to keep powered */
+const void *hid_bond_retain(size_t *len);
+
+/* After a System OFF wake, takes the active slot from retained RAM ahead
+   of the config store.  True if it was restored. */
+bool hid_bond_restore(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
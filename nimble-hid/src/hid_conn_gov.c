@@ -0,0 +1,316 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <string.h>
+
+#include "os/mynewt.h"
+#include "stats/stats.h"
+#include "gatt_svr.h"
+#include "hid_conn_gov.h"
+#include "hid_task.h"
+
+#define GOV_PARAMS_NONE     0
+#define GOV_PARAMS_FAST     1
+#define GOV_PARAMS_IDLE     2
+#define GOV_PARAMS_SUSPEND  3
+
+STATS_SECT_START(hid_conn_gov_stats)
+    STATS_SECT_ENTRY(req_fast)
+    STATS_SECT_ENTRY(req_idle)
+    STATS_SECT_ENTRY(req_suspend)
+    STATS_SECT_ENTRY(to_fast)
+    STATS_SECT_ENTRY(to_idle)
+    STATS_SECT_ENTRY(to_suspend)
+    STATS_SECT_ENTRY(rejected)
+    STATS_SECT_ENTRY(rate_limited)
+    STATS_SECT_ENTRY(req_fail)
+    STATS_SECT_ENTRY(central_update)
+STATS_SECT_END
+
+STATS_NAME_START(hid_conn_gov_stats)
+    STATS_NAME(hid_conn_gov_stats, req_fast)
+    STATS_NAME(hid_conn_gov_stats, req_idle)
+    STATS_NAME(hid_conn_gov_stats, req_suspend)
+    STATS_NAME(hid_conn_gov_stats, to_fast)
+    STATS_NAME(hid_conn_gov_stats, to_idle)
+    STATS_NAME(hid_conn_gov_stats, to_suspend)
+    STATS_NAME(hid_conn_gov_stats, rejected)
+    STATS_NAME(hid_conn_gov_stats, rate_limited)
+    STATS_NAME(hid_conn_gov_stats, req_fail)
+    STATS_NAME(hid_conn_gov_stats, central_update)
+STATS_NAME_END(hid_conn_gov_stats)
+
+static STATS_SECT_DECL(hid_conn_gov_stats) hid_conn_gov_stats;
+
+static const struct ble_gap_upd_params gov_params[] = {
+    [GOV_PARAMS_FAST] = {
+        .itvl_min = MYNEWT_VAL(BLE_HID_CONN_GOV_FAST_ITVL_MIN),
+        .itvl_max = MYNEWT_VAL(BLE_HID_CONN_GOV_FAST_ITVL_MAX),
+        .latency = 0,
+        .supervision_timeout = MYNEWT_VAL(BLE_HID_CONN_GOV_FAST_TIMEOUT),
+    },
+    [GOV_PARAMS_IDLE] = {
+        .itvl_min = MYNEWT_VAL(BLE_HID_CONN_GOV_IDLE_ITVL_MIN),
+        .itvl_max = MYNEWT_VAL(BLE_HID_CONN_GOV_IDLE_ITVL_MAX),
+        .latency = MYNEWT_VAL(BLE_HID_CONN_GOV_IDLE_LATENCY),
+        .supervision_timeout = MYNEWT_VAL(BLE_HID_CONN_GOV_IDLE_TIMEOUT),
+    },
+    [GOV_PARAMS_SUSPEND] = {
+        .itvl_min = MYNEWT_VAL(BLE_HID_CONN_GOV_SUSPEND_ITVL_MIN),
+        .itvl_max = MYNEWT_VAL(BLE_HID_CONN_GOV_SUSPEND_ITVL_MAX),
+        .latency = MYNEWT_VAL(BLE_HID_CONN_GOV_SUSPEND_LATENCY),
+        .supervision_timeout = MYNEWT_VAL(BLE_HID_CONN_GOV_SUSPEND_TIMEOUT),
+    },
+};
+
+static struct {
+    uint16_t conn_handle;
+    bool connected;
+    /* set by the host through the HID Control Point */
+    bool suspended;
+    /* parameter set the link is in, the one wanted and the one requested */
+    uint8_t cur;
+    uint8_t want;
+    uint8_t pending;
+    os_time_t last_activity;
+    /* no request before this time (spacing and backoff) */
+    os_time_t next_req;
+    uint32_t backoff_ms;
+} gov;
+
+static struct os_callout gov_timer;
+static struct os_event gov_kick_ev;
+
+static void
+gov_run(void)
+{
+    os_time_t now = os_time_get();
+    os_time_t wait = 0;
+    os_sr_t sr;
+    int rc;
+
+    if (!gov.connected) {
+        return;
+    }
+
+    OS_ENTER_CRITICAL(sr);
+    if (gov.want == GOV_PARAMS_FAST &&
+        OS_TIME_TICK_GEQ(now, gov.last_activity +
+                         os_time_ms_to_ticks32(MYNEWT_VAL(BLE_HID_CONN_GOV_IDLE_MS)))) {
+        gov.want = GOV_PARAMS_IDLE;
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    if (gov.want == GOV_PARAMS_FAST) {
+        /* check again when the idle period would expire */
+        wait = gov.last_activity +
+               os_time_ms_to_ticks32(MYNEWT_VAL(BLE_HID_CONN_GOV_IDLE_MS)) - now;
+    }
+
+    if (gov.cur != gov.want && gov.pending == GOV_PARAMS_NONE) {
+        if (OS_TIME_TICK_LT(now, gov.next_req)) {
+            STATS_INC(hid_conn_gov_stats, rate_limited);
+            if (wait == 0 || OS_TIME_TICK_LT(gov.next_req - now, wait)) {
+                wait = gov.next_req - now;
+            }
+        } else {
+            rc = ble_gap_update_params(gov.conn_handle, &gov_params[gov.want]);
+            if (rc == 0) {
+                gov.pending = gov.want;
+                switch (gov.want) {
+                case GOV_PARAMS_FAST:
+                    STATS_INC(hid_conn_gov_stats, req_fast);
+                    break;
+                case GOV_PARAMS_SUSPEND:
+                    STATS_INC(hid_conn_gov_stats, req_suspend);
+                    break;
+                default:
+                    STATS_INC(hid_conn_gov_stats, req_idle);
+                    break;
+                }
+            } else {
+                /* e.g. an update started by the central is in progress */
+                STATS_INC(hid_conn_gov_stats, req_fail);
+                BLE_HID_LOG_DEBUG("conn params request failed; rc=%d\n", rc);
+            }
+            gov.next_req = now +
+                os_time_ms_to_ticks32(MYNEWT_VAL(BLE_HID_CONN_GOV_MIN_REQ_GAP_MS));
+            if (rc != 0 && (wait == 0 || OS_TIME_TICK_LT(gov.next_req - now, wait))) {
+                wait = gov.next_req - now;
+            }
+        }
+    }
+
+    if (wait) {
+        os_callout_reset(&gov_timer, wait);
+    } else {
+        os_callout_stop(&gov_timer);
+    }
+}
+
+static void
+gov_event_cb(struct os_event *ev)
+{
+    gov_run();
+}
+
+void
+hid_conn_gov_activity(void)
+{
+    os_sr_t sr;
+    bool kick;
+
+    OS_ENTER_CRITICAL(sr);
+    gov.last_activity = os_time_get();
+    kick = gov.connected && !gov.suspended && gov.want != GOV_PARAMS_FAST;
+    if (kick) {
+        gov.want = GOV_PARAMS_FAST;
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    if (kick) {
+        os_eventq_put(hid_host_evq_get(), &gov_kick_ev);
+    }
+}
+
+void
+hid_conn_gov_suspend(bool suspended)
+{
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    gov.suspended = suspended;
+    if (suspended) {
+        gov.want = GOV_PARAMS_SUSPEND;
+    } else {
+        gov.want = GOV_PARAMS_FAST;
+        gov.last_activity = os_time_get();
+        /* back to low latency at the next connection event */
+        gov.next_req = gov.last_activity;
+    }
+    OS_EXIT_CRITICAL(sr);
+
+    if (gov.connected) {
+        os_eventq_put(hid_host_evq_get(), &gov_kick_ev);
+    }
+}
+
+void
+hid_conn_gov_connected(uint16_t conn_handle)
+{
+    memset(&gov, 0, sizeof(gov));
+    gov.conn_handle = conn_handle;
+    gov.connected = true;
+    gov.backoff_ms = MYNEWT_VAL(BLE_HID_CONN_GOV_BACKOFF_MS);
+    /* discovery and the first keys after a connect benefit from the fast set */
+    gov.want = GOV_PARAMS_FAST;
+    gov.last_activity = os_time_get();
+    gov.next_req = gov.last_activity;
+    gov_run();
+}
+
+void
+hid_conn_gov_disconnected(void)
+{
+    gov.connected = false;
+    os_callout_stop(&gov_timer);
+}
+
+/* do not ask the central again before the backoff expires */
+static void
+gov_backoff(int status)
+{
+    STATS_INC(hid_conn_gov_stats, rejected);
+    gov.next_req = os_time_get() + os_time_ms_to_ticks32(gov.backoff_ms);
+    BLE_HID_LOG_INFO("conn params rejected; status=%d backoff=%lu ms\n",
+                     status, (unsigned long)gov.backoff_ms);
+
+    gov.backoff_ms *= 2;
+    if (gov.backoff_ms > MYNEWT_VAL(BLE_HID_CONN_GOV_BACKOFF_MAX_MS)) {
+        gov.backoff_ms = MYNEWT_VAL(BLE_HID_CONN_GOV_BACKOFF_MAX_MS);
+    }
+}
+
+void
+hid_conn_gov_updated(uint16_t conn_handle, int status)
+{
+    struct ble_gap_conn_desc desc;
+    uint8_t requested = gov.pending;
+
+    if (!gov.connected || conn_handle != gov.conn_handle) {
+        return;
+    }
+    gov.pending = GOV_PARAMS_NONE;
+
+    if (status != 0) {
+        gov_backoff(status);
+        gov_run();
+        return;
+    }
+
+    if (ble_gap_conn_find(conn_handle, &desc) != 0) {
+        return;
+    }
+
+    if (requested == GOV_PARAMS_NONE) {
+        STATS_INC(hid_conn_gov_stats, central_update);
+    }
+
+    /* whatever the central picked, classify what the link runs with now */
+    if (desc.conn_itvl <= MYNEWT_VAL(BLE_HID_CONN_GOV_FAST_ITVL_MAX) &&
+        desc.conn_latency == 0) {
+        if (gov.cur != GOV_PARAMS_FAST) {
+            STATS_INC(hid_conn_gov_stats, to_fast);
+        }
+        gov.cur = GOV_PARAMS_FAST;
+    } else if (desc.conn_itvl >= MYNEWT_VAL(BLE_HID_CONN_GOV_SUSPEND_ITVL_MIN)) {
+        if (gov.cur != GOV_PARAMS_SUSPEND) {
+            STATS_INC(hid_conn_gov_stats, to_suspend);
+        }
+        gov.cur = GOV_PARAMS_SUSPEND;
+    } else {
+        if (gov.cur != GOV_PARAMS_IDLE) {
+            STATS_INC(hid_conn_gov_stats, to_idle);
+        }
+        gov.cur = GOV_PARAMS_IDLE;
+    }
+
+    if (requested != GOV_PARAMS_NONE && gov.cur != requested) {
+        /* the central answered with values of its own, treat like a rejection */
+        gov_backoff(0);
+    } else if (requested != GOV_PARAMS_NONE) {
+        gov.backoff_ms = MYNEWT_VAL(BLE_HID_CONN_GOV_BACKOFF_MS);
+    }
+
+    gov_run();
+}
+
+void
+hid_conn_gov_init(void)
+{
+    int rc;
+
+    os_callout_init(&gov_timer, hid_host_evq_get(), gov_event_cb, NULL);
+    gov_kick_ev.ev_cb = gov_event_cb;
+
+    rc = stats_init_and_reg(STATS_HDR(hid_conn_gov_stats),
+                            STATS_SIZE_INIT_PARMS(hid_conn_gov_stats, STATS_SIZE_32),
+                            STATS_NAME_INIT_PARMS(hid_conn_gov_stats),
+                            "hid_conn_gov");
+    SYSINIT_PANIC_ASSERT(rc == 0);
+}
@@ -0,0 +1,56 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_HID_CONN_GOV_
+#define H_HID_CONN_GOV_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Connection parameter governor.  While reports are being sent the link
+   is asked for a short interval without peripheral latency, after
+   BLE_HID_CONN_GOV_IDLE_MS without reports it steps back to a long interval
+   with peripheral latency.  Requests are spaced and backed off when the
+   central rejects them.  While the host has the device suspended the
+   longest parameter set is used regardless of activity.
+ */
+
+void hid_conn_gov_init(void);
+void hid_conn_gov_connected(uint16_t conn_handle);
+void hid_conn_gov_disconnected(void);
+/* BLE_GAP_EVENT_CONN_UPDATE */
+void hid_conn_gov_updated(uint16_t conn_handle, int status);
+/* a report was sent, cheap enough for every key event */
+void hid_conn_gov_activity(void);
+/*
+   Suspend entered or left, safe from any task.  Leaving suspend asks for
+   the fast set right away, without request spacing or backoff.
+ */
+void hid_conn_gov_suspend(bool suspended);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
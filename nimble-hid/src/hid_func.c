@@ -17,6 +17,23 @@
  * under the License.
  */
 #include "gatt_svr.h"
+#include "defs/error.h"
+#include "stats/stats.h"
+#include "hid_log.h"
+#include "hid_rmap.h"
+#include "hid_conn_gov.h"
+#include "hid_task.h"
+#include "hid_func.h"
+#include "nimble-hid/hid_prof.h"
+#include "nimble-hid/hid_trace.h"
+#include "nimble-hid/nimble-hid.h"
+
+#if MYNEWT_VAL(SHELL_TASK)
+#include "console/console.h"
+#include "shell/shell.h"
+
+static struct shell_cmd hid_send_cli;
+#endif
 
 /*
    10 ms is enough time for writing operation, and
@@ -53,8 +70,10 @@ static struct hid_notify_data {
     int handle_boot_num;   /* handle num in boot mode */
     uint8_t *buffer;            /* data to send */
     size_t buffer_size;
-    bool can_indicate;          /* preffered method, because central will response to it */
+    bool can_indicate;
     bool can_notify;
+    /* indicate when the host allows it, input reports are notified */
+    bool must_deliver;
 } notify_data_reports[] = {
     {   .name = "mouse",
         .handle_num = HANDLE_HID_MOUSE_REPORT,
@@ -85,7 +104,8 @@ static struct hid_notify_data {
         .handle_boot_num = HANDLE_BATTERY_LEVEL,
         .buffer = battery_level,
         .buffer_size = HIDD_LE_BATTERY_LEVEL_SIZE,
-        .can_indicate = false, .can_notify = false},
+        .can_indicate = false, .can_notify = false,
+        .must_deliver = true},
     {   .name = "feature",
         .handle_num = HANDLE_HID_FEATURE_REPORT,
         .handle_boot_num = HANDLE_HID_FEATURE_REPORT,
@@ -94,10 +114,31 @@ static struct hid_notify_data {
         .can_indicate = false, .can_notify = false},
 };
 
+#define NUM_REPORTS (sizeof(notify_data_reports)/sizeof(notify_data_reports[0]))
+
+static uint8_t hid_send_method = MYNEWT_VAL(BLE_HID_SEND_METHOD);
+
+const char * const hid_send_method_names[HID_SEND_METHOD_CNT] = {
+    [HID_SEND_METHOD_CUSTOM] = "custom",
+    [HID_SEND_METHOD_STD] = "std",
+    [HID_SEND_METHOD_ALL] = "all",
+};
+
+/* reports are built but not sent, see hid_send_dry_set() */
+static bool hid_send_dry;
+
+/* notify_data_reports index for every handle_num, -1 if none */
+static int8_t report_idx_by_handle[HANDLE_HID_COUNT];
+
 static struct hid_device_data {
     bool suspended_state;
+    /* battery level changed while suspended, notified on exit */
+    bool battery_deferred;
     bool report_mode_boot;
     bool connected;
+    /* time-to-first-report measurement of the current connection */
+    bool first_report_sent;
+    uint32_t connect_ts;
     uint16_t conn_handle;
 } my_hid_dev = {
     .connected = false,
@@ -105,6 +146,135 @@ static struct hid_device_data {
     .report_mode_boot = false,
 };
 
+STATS_SECT_START(hid_stats)
+    STATS_SECT_ENTRY(rpt_built)
+    STATS_SECT_ENTRY(rpt_sent)
+    STATS_SECT_ENTRY(rpt_unsub)
+    STATS_SECT_ENTRY(notify_err)
+    STATS_SECT_ENTRY(kro_drop)
+    STATS_SECT_ENTRY(pend_queued)
+    STATS_SECT_ENTRY(pend_replayed)
+    STATS_SECT_ENTRY(pend_expired)
+    STATS_SECT_ENTRY(pend_overflow)
+    STATS_SECT_ENTRY(suspend)
+    STATS_SECT_ENTRY(remote_wake)
+STATS_SECT_END
+
+STATS_NAME_START(hid_stats)
+    STATS_NAME(hid_stats, rpt_built)
+    STATS_NAME(hid_stats, rpt_sent)
+    STATS_NAME(hid_stats, rpt_unsub)
+    STATS_NAME(hid_stats, notify_err)
+    STATS_NAME(hid_stats, kro_drop)
+    STATS_NAME(hid_stats, pend_queued)
+    STATS_NAME(hid_stats, pend_replayed)
+    STATS_NAME(hid_stats, pend_expired)
+    STATS_NAME(hid_stats, pend_overflow)
+    STATS_NAME(hid_stats, suspend)
+    STATS_NAME(hid_stats, remote_wake)
+STATS_NAME_END(hid_stats)
+
+static STATS_SECT_DECL(hid_stats) hid_stats;
+
+/* boot to first delivered report, 0 until then */
+static uint32_t hid_boot_report_ms;
+/* connection to its first delivered report, 0 until then */
+static uint32_t hid_conn_report_us;
+
+#if MYNEWT_VAL(BLE_HID_PENDING_REPORTS) > 0
+/*
+   Keyboard and consumer control reports generated while the link is down
+   or the report is not subscribed yet.  Each entry is a snapshot of the
+   whole report.  Every report has its own queue, replayed in order once
+   the host enables that report's CCCD, so a report the host never
+   subscribes to does not hold up the others.  Entries older than
+   BLE_HID_PENDING_EXPIRY_MS are dropped.
+ */
+#define HID_PENDING_LEN     MYNEWT_VAL(BLE_HID_PENDING_REPORTS)
+#define HID_PENDING_QUEUES  2
+
+struct hid_pending_rpt {
+    os_time_t ts;
+    uint8_t handle_num;
+    uint8_t data[HIDD_LE_REPORT_KB_IN_SIZE];
+};
+
+struct hid_pending_q {
+    struct hid_pending_rpt q[HID_PENDING_LEN];
+    /* total number of reports queued and taken out */
+    uint32_t head;
+    uint32_t tail;
+};
+
+static struct {
+    struct hid_pending_q rq[HID_PENDING_QUEUES];
+    /* an indication is in flight, wait for its NOTIFY_TX */
+    bool wait_ack;
+    uint16_t replayed;
+    uint16_t expired;
+    uint16_t overflow;
+} hid_pending;
+
+static void hid_pending_drain(struct os_event *ev);
+int hid_send_report(int report_handle_num);
+
+static struct os_event hid_pending_ev = {
+    .ev_cb = hid_pending_drain,
+};
+#endif
+
+void
+hid_reports_init(void)
+{
+    memset(report_idx_by_handle, -1, sizeof(report_idx_by_handle));
+
+    for (int i = 0; i < NUM_REPORTS; ++i) {
+        report_idx_by_handle[notify_data_reports[i].handle_num] = i;
+        report_idx_by_handle[notify_data_reports[i].handle_boot_num] = i;
+    }
+}
+
+void
+hid_func_init(void)
+{
+    int rc;
+
+    rc = stats_init_and_reg(STATS_HDR(hid_stats),
+                            STATS_SIZE_INIT_PARMS(hid_stats, STATS_SIZE_32),
+                            STATS_NAME_INIT_PARMS(hid_stats),
+                            "hid");
+    SYSINIT_PANIC_ASSERT(rc == 0);
+
+#if MYNEWT_VAL(SHELL_TASK)
+    rc = shell_cmd_register(&hid_send_cli);
+    SYSINIT_PANIC_ASSERT(rc == 0);
+#endif
+}
+
+struct hid_notify_data *
+hid_report_find(int handle_num)
+{
+    if (handle_num < 0 || handle_num >= HANDLE_HID_COUNT ||
+        report_idx_by_handle[handle_num] < 0) {
+        return NULL;
+    }
+    return &notify_data_reports[report_idx_by_handle[handle_num]];
+}
+
+/*
+   Notifications can be queued back to back, an indication blocks the
+   next one until the host confirms it.  Input reports are notified, only
+   must_deliver values prefer indications.
+ */
+static bool
+hid_report_use_indicate(const struct hid_notify_data *rpt)
+{
+    if (rpt->must_deliver) {
+        return rpt->can_indicate;
+    }
+    return rpt->can_indicate && !rpt->can_notify;
+}
+
 /* mark report for indicate/notify when central subscribes to service charachetric with report */
 void
 hid_set_notify(uint16_t attr_handle, uint8_t cur_notify, uint8_t cur_indicate)
@@ -112,7 +282,7 @@ hid_set_notify(uint16_t attr_handle, uint8_t cur_notify, uint8_t cur_indicate)
     int report_idx = -1;
 
     /* find hid_notify_data struct index of reports array for given atribute handle */
-    for (int i = 0; i < sizeof(notify_data_reports)/sizeof(notify_data_reports[0]); ++i) {
+    for (int i = 0; i < NUM_REPORTS; ++i) {
         uint16_t current_handle_idx = my_hid_dev.report_mode_boot ?
                                       notify_data_reports[i].handle_boot_num :
                                       notify_data_reports[i].handle_num;
@@ -127,8 +297,10 @@ hid_set_notify(uint16_t attr_handle, uint8_t cur_notify, uint8_t cur_indicate)
         notify_data_reports[report_idx].can_indicate = cur_indicate;
         notify_data_reports[report_idx].can_notify = cur_notify;
 
-        BLE_HID_LOG_INFO("%s: service %s, attr_handle %d, notify %d, indicate %d\n",
-                    __FUNCTION__, notify_data_reports[report_idx].name, attr_handle, cur_notify, cur_indicate);
+        HID_HLOG_INFO(HID_LOG_NOTIFY_SET, attr_handle, cur_notify, cur_indicate);
+        if (cur_notify || cur_indicate) {
+            hid_pending_resume();
+        }
     }
 }
 
@@ -138,7 +310,7 @@ hid_clean_vars(struct ble_gap_conn_desc *desc)
 {
     memset(&my_hid_dev, 0, sizeof(struct hid_device_data));
 
-    for (int i = 0; i < sizeof(notify_data_reports)/sizeof(notify_data_reports[0]); ++i) {
+    for (int i = 0; i < NUM_REPORTS; ++i) {
         notify_data_reports[i].can_indicate = false;
         notify_data_reports[i].can_notify = false;
         switch (notify_data_reports[i].handle_num) {
@@ -152,22 +324,56 @@ hid_clean_vars(struct ble_gap_conn_desc *desc)
 
     my_hid_dev.conn_handle = desc->conn_handle;
     my_hid_dev.connected = true;
+    my_hid_dev.connect_ts = os_cputime_get32();
+    my_hid_dev.first_report_sent = false;
+    hid_conn_report_us = 0;
+#if MYNEWT_VAL(BLE_HID_PENDING_REPORTS) > 0
+    hid_pending.wait_ack = false;
+#endif
 }
 
 void
 hid_set_disconnected()
 {
     my_hid_dev.connected = false;
+    /* suspend belongs to the link, the next host starts awake */
+    my_hid_dev.suspended_state = false;
 }
 
+/*
+   Suspend (HID Control Point): long connection interval, battery
+   notifications held back and the matrix scan slowed down by the
+   application (ble_hid_suspended()).  Any input report ends it, see
+   hid_send_report().
+ */
 bool
 hid_set_suspend(bool need_suspend)
 {
     bool last_state = my_hid_dev.suspended_state;
+
     my_hid_dev.suspended_state = need_suspend;
+    if (last_state == need_suspend) {
+        return last_state;
+    }
+
+    if (need_suspend) {
+        STATS_INC(hid_stats, suspend);
+    }
+    hid_conn_gov_suspend(need_suspend);
+
+    if (!need_suspend && my_hid_dev.battery_deferred) {
+        my_hid_dev.battery_deferred = false;
+        hid_send_report(HANDLE_BATTERY_LEVEL);
+    }
     return last_state;
 }
 
+bool
+ble_hid_suspended(void)
+{
+    return my_hid_dev.suspended_state;
+}
+
 bool
 hid_set_report_mode(bool is_mode_boot)
 {
@@ -176,46 +382,34 @@ hid_set_report_mode(bool is_mode_boot)
     return old_boot;
 }
 
-static char outbuf[100];
-
-char *
-print_buf(uint8_t *buf, int buf_size)
+/* pack up to 4 bytes of a report big endian, for the binary log */
+static inline uint32_t
+hid_log_pack(const uint8_t *buf, size_t buf_size, size_t off)
 {
-    outbuf[0] = 0;
-    for (int i = 0; i < buf_size; ++i) {
-        sprintf(outbuf + strlen(outbuf),"%s%02X", i?" ":"", buf[i]);
+    uint32_t val = 0;
+
+    for (size_t i = off; i < off + 4; ++i) {
+        val = (val << 8) | (i < buf_size ? buf[i] : 0);
     }
-    return outbuf;
+    return val;
 }
 
 int
 hid_read_buffer(struct os_mbuf *buf, int handle_num)
 {
-    int rc = 0;
-    int rep_idx = -1;
+    struct hid_notify_data *rpt = hid_report_find(handle_num);
+    int rc;
 
-    for (int i = 0; i < sizeof(notify_data_reports)/sizeof(notify_data_reports[0]); ++i) {
-        if (notify_data_reports[i].handle_num == handle_num ||
-            notify_data_reports[i].handle_boot_num == handle_num) {
-            rep_idx = i;
-            break;
-        }
+    if (rpt == NULL) {
+        BLE_HID_LOG_WARN("%s: handle_num %d not found\n", __FUNCTION__, handle_num);
+        return 2;
     }
 
-    if (rep_idx != -1) {
-        rc = os_mbuf_append(buf,
-            notify_data_reports[rep_idx].buffer,
-            notify_data_reports[rep_idx].buffer_size);
+    rc = os_mbuf_append(buf, rpt->buffer, rpt->buffer_size);
 
-        BLE_HID_LOG_INFO("", "%s read data: %s\n", __FUNCTION__,
-             print_buf(notify_data_reports[rep_idx].buffer,
-                 notify_data_reports[rep_idx].buffer_size));
-    } else {
-        if (rep_idx == -1) {
-            BLE_HID_LOG_WARN("%s: handle_num %d not found\n", __FUNCTION__, handle_num);
-        }
-        return 2;
-    }
+    HID_HLOG_DEBUG(HID_LOG_REPORT_READ, handle_num,
+                   hid_log_pack(rpt->buffer, rpt->buffer_size, 0),
+                   hid_log_pack(rpt->buffer, rpt->buffer_size, 4));
 
     return rc;
 }
@@ -223,113 +417,487 @@ hid_read_buffer(struct os_mbuf *buf, int handle_num)
 int
 hid_write_buffer(struct os_mbuf *buf, int handle_num)
 {
+    struct hid_notify_data *rpt = hid_report_find(handle_num);
     int rc = 0;
 
-    int rep_idx = -1;
+    if (rpt == NULL) {
+        return 2;
+    }
 
-    for (int i = 0; i < sizeof(notify_data_reports)/sizeof(notify_data_reports[0]); ++i) {
-        if (notify_data_reports[i].handle_num == handle_num ||
-            notify_data_reports[i].handle_boot_num == handle_num) {
-            rep_idx = i;
-            break;
-        }
+    if (OS_MBUF_PKTLEN(buf) == rpt->buffer_size) {
+        rc = ble_hs_mbuf_to_flat(buf, rpt->buffer, OS_MBUF_PKTLEN(buf), NULL);
+    } else {
+        rc = 4;
     }
-    if (rep_idx != -1) {
-        if (OS_MBUF_PKTLEN(buf) == notify_data_reports[rep_idx].buffer_size) {
-            rc = ble_hs_mbuf_to_flat(buf,
-                notify_data_reports[rep_idx].buffer,
-                OS_MBUF_PKTLEN(buf),
-                NULL);
-        } else {
-            rc = 4;
+    if (rc == 0) {
+        if (handle_num == HANDLE_HID_KB_OUT_REPORT) {
+            /*
+               change LEDs level when Keyboard out report received
+               set_leds(Leds_buffer[0]);
+             */
         }
-        if (rc == 0) {
-            if (handle_num == HANDLE_HID_KB_OUT_REPORT) {
-                /*
-                   change LEDs level when Keyboard out report received
-                   set_leds(Leds_buffer[0]);
-                 */
+    }
+
+    return rc;
+}
+
+/* check that every report buffer matches the size declared in the report map */
+int
+hid_validate_report_map(const uint8_t *map, size_t map_size)
+{
+    struct hid_rmap_info info;
+    const struct hid_rmap_report *rpt;
+    int rc;
+
+    rc = hid_rmap_parse(map, map_size, &info);
+    if (rc) {
+        BLE_HID_LOG_ERROR("%s: malformed report map, rc = %d\n", __FUNCTION__, rc);
+        return rc;
+    }
+
+    for (int i = 0; i < NUM_REPORTS; ++i) {
+        const uint8_t *ref = NULL;
+        int len;
+
+        for (int j = 0; j < hid_report_ref_data_count; ++j) {
+            if (hid_report_ref_data[j].id == notify_data_reports[i].handle_num) {
+                ref = hid_report_ref_data[j].hidReportRef;
+                break;
             }
         }
-    } else {
-        return 2;
+        if (ref == NULL) {
+            /* not a HID report (battery level) */
+            continue;
+        }
+
+        len = hid_rmap_report_len(&info, ref[0], ref[1]);
+        if (len < 0) {
+            BLE_HID_LOG_WARN("%s: report %s (id %d type %d) is not in the report map\n",
+                             __FUNCTION__, notify_data_reports[i].name, ref[0], ref[1]);
+            continue;
+        }
+        if (len != notify_data_reports[i].buffer_size) {
+            BLE_HID_LOG_ERROR("%s: report %s (id %d type %d) is %d bytes, buffer is %d\n",
+                              __FUNCTION__, notify_data_reports[i].name, ref[0], ref[1],
+                              len, (int)notify_data_reports[i].buffer_size);
+            rc = SYS_EINVAL;
+        }
+    }
+
+    /* the keyboard report is also sent on the boot characteristic */
+    rpt = hid_rmap_find(&info, HID_RPT_ID_KB_IN);
+    if (rpt == NULL || !(rpt->boot_flags & HID_RMAP_BOOT_KBD)) {
+        BLE_HID_LOG_ERROR("%s: keyboard report is not boot compatible\n", __FUNCTION__);
+        rc = SYS_EINVAL;
     }
 
     return rc;
 }
 
-/*  send report to central using different ways
-    0 - using ble_gattc_indicate_custom     using custom buffer
-    1 - using ble_gattc_indicate            to only one connection
-    2 - using ble_gatts_chr_updated         to all connected centrals
- */
-#define SEND_METHOD_CUSTOM  0
-#define SEND_METHOD_STD     1
-#define SEND_METHOD_ALL     2
+#if MYNEWT_VAL(BLE_HID_PENDING_REPORTS) > 0 || MYNEWT_VAL(BLE_HID_BENCH)
+static bool
+hid_report_ready(const struct hid_notify_data *rpt)
+{
+    return my_hid_dev.connected && (rpt->can_notify || rpt->can_indicate);
+}
+#endif
 
-#define NOTIFY_METHOD SEND_METHOD_STD
+#if MYNEWT_VAL(BLE_HID_PENDING_REPORTS) > 0
+static bool
+hid_pending_q_empty(const struct hid_pending_q *q)
+{
+    return q->head == q->tail;
+}
 
-/* send report data to central using notify/indicate */
-int
-hid_send_report(int report_handle_num)
+static bool
+hid_pending_empty(void)
 {
-    int report_idx = -1;
+    for (int i = 0; i < HID_PENDING_QUEUES; ++i) {
+        if (!hid_pending_q_empty(&hid_pending.rq[i])) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    for (int i = 0; i < sizeof(notify_data_reports)/sizeof(notify_data_reports[0]); ++i) {
-        if (report_handle_num == notify_data_reports[i].handle_num) {
-            report_idx = i;
+/* queue of a report worth typing late, NULL for pointer motion */
+static struct hid_pending_q *
+hid_pending_queue(int handle_num)
+{
+    switch (handle_num) {
+    case HANDLE_HID_KB_IN_REPORT:
+        return &hid_pending.rq[0];
+    case HANDLE_HID_CC_REPORT:
+        return &hid_pending.rq[1];
+    default:
+        return NULL;
+    }
+}
+
+static void
+hid_pending_put(struct hid_pending_q *q, const struct hid_notify_data *rpt)
+{
+    struct hid_pending_rpt *ent;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    if (q->head - q->tail >= HID_PENDING_LEN) {
+        /* every entry is a full snapshot, losing the oldest only loses taps */
+        q->tail++;
+        hid_pending.overflow++;
+        STATS_INC(hid_stats, pend_overflow);
+    }
+    ent = &q->q[q->head++ % HID_PENDING_LEN];
+    ent->ts = os_time_get();
+    ent->handle_num = rpt->handle_num;
+    memcpy(ent->data, rpt->buffer, rpt->buffer_size);
+    OS_EXIT_CRITICAL(sr);
+
+    STATS_INC(hid_stats, pend_queued);
+}
+
+static int
+hid_pending_send(const struct hid_notify_data *rpt, const uint8_t *data)
+{
+    struct os_mbuf *om;
+    uint16_t send_handle;
+
+    send_handle = svc_char_handles[my_hid_dev.report_mode_boot ?
+                                   rpt->handle_boot_num : rpt->handle_num];
+    om = ble_hs_mbuf_from_flat(data, rpt->buffer_size);
+    if (om == NULL) {
+        return BLE_HS_ENOMEM;
+    }
+
+    if (!hid_report_use_indicate(rpt)) {
+        return ble_gattc_notify_custom(my_hid_dev.conn_handle, send_handle, om);
+    }
+    hid_pending.wait_ack = true;
+    return ble_gattc_indicate_custom(my_hid_dev.conn_handle, send_handle, om);
+}
+
+/*
+   Takes out the expired entries and returns the queue whose oldest entry
+   is next to replay: the oldest among the reports the host is ready for.
+   Called in a critical section, hid_pending_put() runs in other tasks.
+ */
+static struct hid_pending_q *
+hid_pending_next(os_time_t now, os_time_t expiry)
+{
+    struct hid_pending_q *next = NULL;
+    struct hid_pending_rpt *ent;
+    struct hid_pending_q *q;
+
+    for (int i = 0; i < HID_PENDING_QUEUES; ++i) {
+        q = &hid_pending.rq[i];
+        while (!hid_pending_q_empty(q) &&
+               now - q->q[q->tail % HID_PENDING_LEN].ts > expiry) {
+            q->tail++;
+            hid_pending.expired++;
+            STATS_INC(hid_stats, pend_expired);
+        }
+        if (hid_pending_q_empty(q)) {
+            continue;
+        }
+        ent = &q->q[q->tail % HID_PENDING_LEN];
+        if (!hid_report_ready(hid_report_find(ent->handle_num))) {
+            /* keep this report's order, wait for its CCCD */
+            continue;
+        }
+        if (next == NULL ||
+            OS_TIME_TICK_LT(ent->ts, next->q[next->tail % HID_PENDING_LEN].ts)) {
+            next = q;
+        }
+    }
+
+    return next;
+}
+
+/* replay the queues as fast as the host stack takes the reports */
+static void
+hid_pending_drain(struct os_event *ev)
+{
+    struct hid_pending_rpt ent;
+    struct hid_notify_data *rpt;
+    struct hid_pending_q *q;
+    os_time_t expiry;
+    uint32_t tail;
+    os_sr_t sr;
+    int rc;
+
+    expiry = os_time_ms_to_ticks32(MYNEWT_VAL(BLE_HID_PENDING_EXPIRY_MS));
+
+    while (!hid_pending.wait_ack) {
+        OS_ENTER_CRITICAL(sr);
+        q = hid_pending_next(os_time_get(), expiry);
+        if (q == NULL) {
+            OS_EXIT_CRITICAL(sr);
             break;
         }
+        tail = q->tail;
+        ent = q->q[tail % HID_PENDING_LEN];
+        OS_EXIT_CRITICAL(sr);
+
+        rpt = hid_report_find(ent.handle_num);
+        rc = hid_pending_send(rpt, ent.data);
+        HID_TRACE(HID_TRACE_REPORT_SEND, rc, ent.handle_num, 1);
+        if (rc == BLE_HS_ENOMEM) {
+            /* out of mbufs, retried on the next NOTIFY_TX */
+            hid_pending.wait_ack = false;
+            return;
+        }
+        if (rc != 0) {
+            BLE_HID_LOG_ERROR("%s: replay failed; rc=%d\n", __FUNCTION__, rc);
+            hid_pending.wait_ack = false;
+            return;
+        }
+        hid_pending.replayed++;
+        STATS_INC(hid_stats, pend_replayed);
+
+        OS_ENTER_CRITICAL(sr);
+        /* an overflow in hid_pending_put() may have dropped it meanwhile */
+        if (q->tail == tail) {
+            q->tail++;
+        }
+        OS_EXIT_CRITICAL(sr);
     }
 
-    if (report_idx == -1) {
-        BLE_HID_LOG_WARN("%s: Unknown report_handle_num %d\n", __FUNCTION__, report_handle_num);
-        return 2;
+    if (hid_pending_empty() && (hid_pending.replayed || hid_pending.expired)) {
+        BLE_HID_LOG_INFO("pending reports: %u replayed, %u expired, %u lost\n",
+                         hid_pending.replayed, hid_pending.expired,
+                         hid_pending.overflow);
+        hid_pending.replayed = 0;
+        hid_pending.expired = 0;
+        hid_pending.overflow = 0;
     }
+}
+#endif
+
+void
+hid_pending_resume(void)
+{
+#if MYNEWT_VAL(BLE_HID_PENDING_REPORTS) > 0
+    if (!hid_pending_empty()) {
+        os_eventq_put(hid_evq_get(), &hid_pending_ev);
+    }
+#endif
+}
+
+uint32_t
+hid_boot_report_time(void)
+{
+    return hid_boot_report_ms;
+}
 
+uint32_t
+hid_conn_report_time(void)
+{
+    return hid_conn_report_us;
+}
+
+int
+hid_send_method_set(int method)
+{
+    if (method < 0 || method >= HID_SEND_METHOD_CNT) {
+        return SYS_EINVAL;
+    }
+    hid_send_method = method;
+    return 0;
+}
+
+int
+hid_send_method_get(void)
+{
+    return hid_send_method;
+}
+
+static int
+hid_report_tx(const struct hid_notify_data *rpt)
+{
+    struct os_mbuf *om;
     uint16_t send_handle;
-    int rc = 0;
+    bool indicate;
 
     if (my_hid_dev.report_mode_boot) {
-        send_handle = svc_char_handles[notify_data_reports[report_idx].handle_boot_num];
+        send_handle = svc_char_handles[rpt->handle_boot_num];
     } else {
-        send_handle = svc_char_handles[notify_data_reports[report_idx].handle_num];
+        send_handle = svc_char_handles[rpt->handle_num];
     }
+    indicate = hid_report_use_indicate(rpt);
 
-    switch (NOTIFY_METHOD) {
-    case SEND_METHOD_CUSTOM: {
-        struct os_mbuf *om = ble_hs_mbuf_from_flat(
-                    notify_data_reports[report_idx].buffer,
-                    notify_data_reports[report_idx].buffer_size);
+    switch (hid_send_method) {
+    case HID_SEND_METHOD_CUSTOM:
+        if (!rpt->can_notify && !rpt->can_indicate) {
+            return 0;
+        }
+        om = ble_hs_mbuf_from_flat(rpt->buffer, rpt->buffer_size);
+        if (om == NULL) {
+            return BLE_HS_ENOMEM;
+        }
+        if (indicate) {
+            return ble_gattc_indicate_custom(my_hid_dev.conn_handle, send_handle, om);
+        }
+        return ble_gattc_notify_custom(my_hid_dev.conn_handle, send_handle, om);
 
-        if (notify_data_reports[report_idx].can_indicate) {
-            rc = ble_gattc_indicate_custom(my_hid_dev.conn_handle, send_handle, om);
-        } else if (notify_data_reports[report_idx].can_notify) {
-            rc = ble_gattc_notify_custom(my_hid_dev.conn_handle, send_handle, om);
+    case HID_SEND_METHOD_ALL:
+        /* the host stack picks notify or indicate from the CCCD */
+        ble_gatts_chr_updated(send_handle);
+        return 0;
+
+    default:
+        if (indicate) {
+            return ble_gattc_indicate(my_hid_dev.conn_handle, send_handle);
+        } else if (rpt->can_notify) {
+            return ble_gattc_notify(my_hid_dev.conn_handle, send_handle);
         }
-        break;
+        return 0;
     }
+}
+
+#if MYNEWT_VAL(BLE_HID_BENCH)
+int
+hid_kb_report_tx(bool *indicate)
+{
+    struct hid_notify_data *rpt = hid_report_find(HANDLE_HID_KB_IN_REPORT);
+
+    if (!hid_report_ready(rpt)) {
+        return SYS_EAGAIN;
+    }
+    *indicate = hid_report_use_indicate(rpt);
+    return hid_report_tx(rpt);
+}
+#endif
 
-    case SEND_METHOD_STD:
-        if (notify_data_reports[report_idx].can_indicate) {
-            rc = ble_gattc_indicate(my_hid_dev.conn_handle, send_handle);
-        } else if (notify_data_reports[report_idx].can_notify) {
-            rc = ble_gattc_notify(my_hid_dev.conn_handle, send_handle);
+#if MYNEWT_VAL(SHELL_TASK)
+static int
+hid_send_cli_cmd(int argc, char **argv)
+{
+    int i;
+
+    if (argc < 2) {
+        console_printf("%s\n", hid_send_method_names[hid_send_method]);
+        return 0;
+    }
+
+    for (i = 0; i < HID_SEND_METHOD_CNT; ++i) {
+        if (!strcmp(argv[1], hid_send_method_names[i])) {
+            return hid_send_method_set(i);
         }
-        break;
+    }
 
-    case SEND_METHOD_ALL:
-        ble_gatts_chr_updated(send_handle);
-        rc = 0;
-        break;
+    console_printf("usage: hidsend [custom|std|all]\n");
+    return SYS_EINVAL;
+}
+
+static struct shell_cmd hid_send_cli = {
+    .sc_cmd = "hidsend",
+    .sc_cmd_func = hid_send_cli_cmd,
+};
+#endif
+
+void
+hid_notify_tx_done(uint16_t attr_handle, int status, bool indication)
+{
+    if (indication && status == 0) {
+        /* queued, the indication is done once the host confirms it */
+        return;
+    }
+
+#if MYNEWT_VAL(BLE_HID_BENCH)
+    if (attr_handle == svc_char_handles[my_hid_dev.report_mode_boot ?
+                                        HANDLE_HID_BOOT_KB_IN_REPORT :
+                                        HANDLE_HID_KB_IN_REPORT]) {
+        hid_bench_kb_tx_done(status == (indication ? BLE_HS_EDONE : 0));
+    }
+#endif
+#if MYNEWT_VAL(BLE_HID_PENDING_REPORTS) > 0
+    if (indication) {
+        hid_pending.wait_ack = false;
+    }
+    hid_pending_resume();
+#endif
+}
+
+/* send report data to central using notify/indicate */
+int
+hid_send_report(int report_handle_num)
+{
+    HID_PROF_SCOPE(HID_PROF_SEND_REPORT);
+    struct hid_notify_data *rpt = hid_report_find(report_handle_num);
+
+    if (rpt == NULL) {
+        BLE_HID_LOG_WARN("%s: Unknown report_handle_num %d\n", __FUNCTION__, report_handle_num);
+        return 2;
+    }
+
+    int rc = 0;
+
+    if (hid_send_dry) {
+        return 0;
+    }
+
+    if (my_hid_dev.suspended_state) {
+        if (report_handle_num == HANDLE_BATTERY_LEVEL) {
+            my_hid_dev.battery_deferred = true;
+            return 0;
+        }
+        /* a key while suspended is the remote wake, the report goes out
+         * right away and the fast connection parameters follow */
+        STATS_INC(hid_stats, remote_wake);
+        BLE_HID_LOG_INFO("remote wake\n");
+        hid_set_suspend(false);
     }
+
+    STATS_INC(hid_stats, rpt_built);
+
+#if MYNEWT_VAL(BLE_HID_PENDING_REPORTS) > 0
+    struct hid_pending_q *q = hid_pending_queue(report_handle_num);
+
+    if (q != NULL && (!hid_report_ready(rpt) || !hid_pending_q_empty(q))) {
+        /* queued behind older reports of its kind or until the host is back */
+        hid_pending_put(q, rpt);
+        hid_pending_resume();
+        return 0;
+    }
+#endif
+
+    rc = hid_report_tx(rpt);
+    HID_TRACE(HID_TRACE_REPORT_SEND, rc, report_handle_num, 0);
+    if (report_handle_num != HANDLE_BATTERY_LEVEL) {
+        hid_conn_gov_activity();
+    }
+    if (rc) {
+        STATS_INC(hid_stats, notify_err);
+    } else if (rpt->can_notify || rpt->can_indicate) {
+        STATS_INC(hid_stats, rpt_sent);
+    } else {
+        STATS_INC(hid_stats, rpt_unsub);
+    }
+
     if (rc) {
         BLE_HID_LOG_ERROR("%s: Notify error in function\n", __FUNCTION__);
+    } else if (!my_hid_dev.first_report_sent && report_handle_num != HANDLE_BATTERY_LEVEL) {
+        my_hid_dev.first_report_sent = true;
+        hid_conn_report_us = os_cputime_ticks_to_usecs(os_cputime_get32() -
+                                                       my_hid_dev.connect_ts);
+        BLE_HID_LOG_INFO("first report %lu ms after connect\n",
+                         (unsigned long)hid_conn_report_us / 1000);
+        if (hid_boot_report_ms == 0) {
+            hid_boot_report_ms = os_get_uptime_usec() / 1000;
+            BLE_HID_LOG_INFO("first report %lu ms after boot\n",
+                             (unsigned long)hid_boot_report_ms);
+        }
     }
 
     return 0;
 }
 
+void
+hid_send_dry_set(bool dry)
+{
+    hid_send_dry = dry;
+}
+
 uint8_t
 hid_battery_level_get(void)
 {
@@ -484,10 +1052,29 @@ hid_cc_change_key(int key, bool pressed)
     return rc;
 }
 
+/*
+   tmk drops a press silently when all six key slots are taken, and still
+   sends the report.  A full report that repeats the previous one is
+   counted as such a drop.
+ */
+static bool
+hid_kb_report_kro_full(const uint8_t *report)
+{
+    for (int i = 2; i < HIDD_LE_REPORT_KB_IN_SIZE; ++i) {
+        if (report[i] == 0) {
+            return false;
+        }
+    }
+    return memcmp(report, keyboard_buffer, HIDD_LE_REPORT_KB_IN_SIZE) == 0;
+}
+
 int
 hid_send_keyboard_report(const void* report, size_t report_size)
 {
     assert(HIDD_LE_REPORT_KB_IN_SIZE == report_size);
+    if (hid_kb_report_kro_full(report)) {
+        STATS_INC(hid_stats, kro_drop);
+    }
     memcpy(keyboard_buffer, report, report_size);
     return hid_send_report(HANDLE_HID_KB_IN_REPORT);
 }
@@ -536,6 +1123,9 @@ hid_keyboard_change_key(uint8_t key, bool pressed)
         }
         if (!found) {
             rc = 1; /* no room for new key or key not found */
+            if (pressed) {
+                STATS_INC(hid_stats, kro_drop);
+            }
         }
     }
 
@@ -21,17 +21,56 @@
 
 #include "host/ble_gap.h"
 
+extern void hid_reports_init(void);
+/* stats and the "hidsend" shell command, once at startup */
+extern void hid_func_init(void);
 extern void hid_clean_vars(struct ble_gap_conn_desc *desc);
 extern void hid_set_disconnected();
 extern void hid_set_notify(uint16_t attr_handle, uint8_t cur_notify, uint8_t cur_indicate);
 extern bool hid_set_suspend(bool need_suspend);
 extern bool hid_set_report_mode(bool boot_mode);
+/* replay reports queued while the link or the CCCD was down */
+extern void hid_pending_resume(void);
+/* BLE_GAP_EVENT_NOTIFY_TX */
+extern void hid_notify_tx_done(uint16_t attr_handle, int status, bool indication);
+
+/*  Ways to send a report to the central
+    custom - ble_gattc_notify/indicate_custom with a copy of the report
+    std    - ble_gattc_notify/indicate, the stack reads the attribute
+    all    - ble_gatts_chr_updated to every subscribed central
+ */
+#define HID_SEND_METHOD_CUSTOM  0
+#define HID_SEND_METHOD_STD     1
+#define HID_SEND_METHOD_ALL     2
+#define HID_SEND_METHOD_CNT     3
+
+extern const char * const hid_send_method_names[HID_SEND_METHOD_CNT];
+extern int hid_send_method_set(int method);
+extern int hid_send_method_get(void);
+
+struct hid_notify_data;
+/* report of a handle_num (HANDLE_HID_*), NULL if there is none */
+extern struct hid_notify_data *hid_report_find(int handle_num);
+
+/* build reports without sending them, for the benchmarks */
+extern void hid_send_dry_set(bool dry);
+/* "hidbench" shell command, BLE_HID_BENCH */
+extern void hid_bench_init(void);
+/* keyboard input report delivered ('ok') or dropped */
+extern void hid_bench_kb_tx_done(bool ok);
+/*
+   Sends the current keyboard input report with the selected method,
+   SYS_EAGAIN if the host is not subscribed.  '*indicate' tells whether
+   the report waits for the host's confirmation.
+ */
+extern int hid_kb_report_tx(bool *indicate);
 
 extern uint8_t hid_battery_level_get(void);
 
 extern int hid_battery_level_set(uint8_t level);
 extern int hid_keyboard_change_key(uint8_t key, bool pressed);
 extern int hid_cc_change_key(int key, bool pressed);
+extern int hid_cc_build_report(uint8_t *buffer, uint8_t cmd, bool pressed);
 extern int hid_mouse_change_key(int cmd, int8_t move_x, int8_t move_y, bool pressed);
 extern int hid_leds_write(struct os_mbuf *buf);
 
@@ -39,4 +78,6 @@ extern int hid_write_buffer(struct os_mbuf *buf, int handle_num);
 
 extern int hid_read_buffer(struct os_mbuf *buf, int handle_num);
 
+extern int hid_validate_report_map(const uint8_t *map, size_t map_size);
+
 #endif
@@ -0,0 +1,179 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "os/mynewt.h"
+#include "hid_log.h"
+
+#if MYNEWT_VAL(BLE_HID_HLOG_ENTRIES) > 0
+
+#if MYNEWT_VAL(SHELL_TASK)
+#include <string.h>
+#include "console/console.h"
+#include "shell/shell.h"
+#endif
+
+#if MYNEWT_VAL(BLE_HID_HLOG_MGMT)
+#include "hid_ring_mgmt.h"
+#endif
+
+#define HID_LOG_ENTRIES MYNEWT_VAL(BLE_HID_HLOG_ENTRIES)
+
+/* arg0 is printed with %u/%x, arg1 and arg2 with %lu/%lx */
+static const char * const hid_log_fmts[HID_LOG_ID_CNT] = {
+    [HID_LOG_ATTR_READ]         = "attr read: attr %04x op %lu",
+    [HID_LOG_REPORT_ACCESS]     = "report access: attr %04x handle_num %lu op %lu",
+    [HID_LOG_REPORT_READ]       = "report read: handle_num %u data %08lx%08lx",
+    [HID_LOG_SUBSCRIBE]         = "subscribe: attr %04x reason %lu flags %lx",
+    [HID_LOG_NOTIFY_SET]        = "notify set: attr %04x notify %lu indicate %lu",
+    [HID_LOG_NOTIFY_TX]         = "notify tx: attr %04x status %lu indication %lu",
+};
+
+static struct hid_log_rec hid_log_ring[HID_LOG_ENTRIES];
+/* total number of records ever written, the ring holds the last ones */
+static uint32_t hid_log_head;
+
+void
+hid_log_put(uint16_t id, uint16_t arg0, uint32_t arg1, uint32_t arg2)
+{
+    struct hid_log_rec *rec;
+    os_sr_t sr;
+
+    /* filled under the lock, readers never see a claimed but unwritten slot */
+    OS_ENTER_CRITICAL(sr);
+    rec = &hid_log_ring[hid_log_head++ % HID_LOG_ENTRIES];
+    rec->ts = os_cputime_get32();
+    rec->id = id;
+    rec->arg0 = arg0;
+    rec->arg1 = arg1;
+    rec->arg2 = arg2;
+    OS_EXIT_CRITICAL(sr);
+}
+
+#if MYNEWT_VAL(BLE_HID_HLOG_MGMT)
+
+/* Command IDs of the hid_log group */
+#define HID_LOG_MGMT_ID_READ        0
+#define HID_LOG_MGMT_ID_CLEAR       1
+
+#define HID_LOG_MGMT_CHUNK          MYNEWT_VAL(BLE_HID_HLOG_MGMT_CHUNK)
+
+static struct hid_log_rec hid_log_chunk[HID_LOG_MGMT_CHUNK];
+
+/* Same paging as the trace group, decoded with tools/hid_trace_decode.py --hlog */
+static const struct hid_ring_mgmt hid_log_mgmt_ring = {
+    .ring = hid_log_ring,
+    .head = &hid_log_head,
+    .chunk = hid_log_chunk,
+    .rec_size = sizeof(hid_log_chunk[0]),
+    .entries = HID_LOG_ENTRIES,
+    .chunk_max = HID_LOG_MGMT_CHUNK,
+};
+
+static int
+hid_log_mgmt_read(struct mgmt_ctxt *ctxt)
+{
+    return hid_ring_mgmt_read(ctxt, &hid_log_mgmt_ring);
+}
+
+static int
+hid_log_mgmt_clear(struct mgmt_ctxt *ctxt)
+{
+    return hid_ring_mgmt_clear(ctxt, &hid_log_mgmt_ring);
+}
+
+static const struct mgmt_handler hid_log_mgmt_handlers[] = {
+    [HID_LOG_MGMT_ID_READ] = {
+        .mh_read = hid_log_mgmt_read,
+        .mh_write = NULL,
+    },
+    [HID_LOG_MGMT_ID_CLEAR] = {
+        .mh_read = NULL,
+        .mh_write = hid_log_mgmt_clear,
+    },
+};
+
+static struct mgmt_group hid_log_mgmt_group = {
+    .mg_handlers = hid_log_mgmt_handlers,
+    .mg_handlers_count = sizeof(hid_log_mgmt_handlers) / sizeof(hid_log_mgmt_handlers[0]),
+    .mg_group_id = MYNEWT_VAL(BLE_HID_HLOG_MGMT_GROUP),
+};
+#endif
+
+#if MYNEWT_VAL(SHELL_TASK)
+static void
+hid_log_dump(void)
+{
+    struct hid_log_rec rec;
+    uint32_t head;
+    uint32_t idx;
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    head = hid_log_head;
+    OS_EXIT_CRITICAL(sr);
+
+    idx = head > HID_LOG_ENTRIES ? head - HID_LOG_ENTRIES : 0;
+    for (; idx != head; ++idx) {
+        rec = hid_log_ring[idx % HID_LOG_ENTRIES];
+        if (rec.id >= HID_LOG_ID_CNT) {
+            continue;
+        }
+        console_printf("%lu: ", (unsigned long)os_cputime_ticks_to_usecs(rec.ts));
+        console_printf(hid_log_fmts[rec.id], (unsigned)rec.arg0,
+                       (unsigned long)rec.arg1, (unsigned long)rec.arg2);
+        console_printf("\n");
+    }
+}
+
+static int
+hid_log_cli_cmd(int argc, char **argv)
+{
+    os_sr_t sr;
+
+    if (argc > 1 && !strcmp(argv[1], "clear")) {
+        OS_ENTER_CRITICAL(sr);
+        hid_log_head = 0;
+        OS_EXIT_CRITICAL(sr);
+        return 0;
+    }
+
+    hid_log_dump();
+    return 0;
+}
+
+static struct shell_cmd hid_log_cli = {
+    .sc_cmd = "hidlog",
+    .sc_cmd_func = hid_log_cli_cmd,
+};
+#endif
+
+void
+hid_log_init(void)
+{
+#if MYNEWT_VAL(SHELL_TASK)
+    int rc;
+
+    rc = shell_cmd_register(&hid_log_cli);
+    SYSINIT_PANIC_ASSERT(rc == 0);
+#endif
+#if MYNEWT_VAL(BLE_HID_HLOG_MGMT)
+    mgmt_register_group(&hid_log_mgmt_group);
+#endif
+}
+
+#endif
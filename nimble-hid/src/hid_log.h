@@ -0,0 +1,85 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_HID_LOG_
+#define H_HID_LOG_
+
+#include <stdint.h>
+#include "syscfg/syscfg.h"
+#include "log_common/log_common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Binary log for the GATT/notify hot path.  Sites store a fixed-size
+   record (id, three arguments, cputime stamp) in a RAM ring, the text is
+   only formatted when the ring is dumped from the shell ("hidlog") or,
+   for rings read over SMP (BLE_HID_HLOG_MGMT), by
+   tools/hid_trace_decode.py --hlog.
+ */
+
+/* Record ids, the format string of each is in hid_log.c and the decoder */
+enum hid_log_id {
+    HID_LOG_ATTR_READ,          /* attr_handle, op */
+    HID_LOG_REPORT_ACCESS,      /* attr_handle, handle_num, op */
+    HID_LOG_REPORT_READ,        /* handle_num, data[0..3], data[4..7] */
+    HID_LOG_SUBSCRIBE,          /* attr_handle, reason, prev/cur flags */
+    HID_LOG_NOTIFY_SET,         /* attr_handle, notify, indicate */
+    HID_LOG_NOTIFY_TX,          /* attr_handle, status, indication */
+    HID_LOG_ID_CNT
+};
+
+struct hid_log_rec {
+    uint32_t ts;
+    uint16_t id;
+    uint16_t arg0;
+    uint32_t arg1;
+    uint32_t arg2;
+};
+
+#if MYNEWT_VAL(BLE_HID_HLOG_ENTRIES) > 0
+void hid_log_put(uint16_t id, uint16_t arg0, uint32_t arg1, uint32_t arg2);
+void hid_log_init(void);
+#define HID_HLOG(id, a0, a1, a2) \
+    hid_log_put((id), (uint16_t)(a0), (uint32_t)(a1), (uint32_t)(a2))
+#else
+#define hid_log_init()
+#define HID_HLOG(id, a0, a1, a2)
+#endif
+
+/* Sites below the configured BLE_HID_LOG_LVL are compiled out */
+#if MYNEWT_VAL(BLE_HID_LOG_LVL) <= LOG_LEVEL_DEBUG
+#define HID_HLOG_DEBUG(id, a0, a1, a2) HID_HLOG(id, a0, a1, a2)
+#else
+#define HID_HLOG_DEBUG(id, a0, a1, a2)
+#endif
+
+#if MYNEWT_VAL(BLE_HID_LOG_LVL) <= LOG_LEVEL_INFO
+#define HID_HLOG_INFO(id, a0, a1, a2) HID_HLOG(id, a0, a1, a2)
+#else
+#define HID_HLOG_INFO(id, a0, a1, a2)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,218 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "os/mynewt.h"
+#include "stats/stats.h"
+#include "gatt_svr.h"
+#include "hid_phy.h"
+#include "hid_task.h"
+
+STATS_SECT_START(hid_phy_stats)
+    STATS_SECT_ENTRY(req_2m)
+    STATS_SECT_ENTRY(req_coded)
+    STATS_SECT_ENTRY(req_fail)
+    STATS_SECT_ENTRY(upd_fail)
+    STATS_SECT_ENTRY(to_1m)
+    STATS_SECT_ENTRY(to_2m)
+    STATS_SECT_ENTRY(to_coded)
+    STATS_SECT_ENTRY(weak_rssi)
+    STATS_SECT_ENTRY(weak_spvn_to)
+STATS_SECT_END
+
+STATS_NAME_START(hid_phy_stats)
+    STATS_NAME(hid_phy_stats, req_2m)
+    STATS_NAME(hid_phy_stats, req_coded)
+    STATS_NAME(hid_phy_stats, req_fail)
+    STATS_NAME(hid_phy_stats, upd_fail)
+    STATS_NAME(hid_phy_stats, to_1m)
+    STATS_NAME(hid_phy_stats, to_2m)
+    STATS_NAME(hid_phy_stats, to_coded)
+    STATS_NAME(hid_phy_stats, weak_rssi)
+    STATS_NAME(hid_phy_stats, weak_spvn_to)
+STATS_NAME_END(hid_phy_stats)
+
+static STATS_SECT_DECL(hid_phy_stats) hid_phy_stats;
+
+/* PHY of a good link */
+#if MYNEWT_VAL(BLE_HID_PHY_2M)
+#define PHY_DEFAULT     BLE_GAP_LE_PHY_2M
+#else
+#define PHY_DEFAULT     BLE_GAP_LE_PHY_1M
+#endif
+
+static struct {
+    uint16_t conn_handle;
+    bool connected;
+    /* PHY of the link and the one asked for */
+    uint8_t cur;
+    uint8_t want;
+    /* RSSI average in 1/8 dBm, 0 until the first sample */
+    int16_t rssi_avg;
+    /* the last link was lost to a supervision timeout */
+    bool weak_link;
+} phy;
+
+#if MYNEWT_VAL(BLE_HID_PHY_CODED_FALLBACK)
+static struct os_callout phy_rssi_timer;
+#endif
+
+static void
+phy_request(uint8_t want)
+{
+    uint8_t mask;
+    int rc;
+
+    if (!phy.connected || want == phy.want) {
+        return;
+    }
+
+    switch (want) {
+    case BLE_GAP_LE_PHY_CODED:
+        mask = BLE_GAP_LE_PHY_CODED_MASK;
+        STATS_INC(hid_phy_stats, req_coded);
+        break;
+    case BLE_GAP_LE_PHY_2M:
+        mask = BLE_GAP_LE_PHY_2M_MASK;
+        STATS_INC(hid_phy_stats, req_2m);
+        break;
+    default:
+        mask = BLE_GAP_LE_PHY_1M_MASK;
+        break;
+    }
+
+    rc = ble_gap_set_prefered_le_phy(phy.conn_handle, mask, mask,
+                                     MYNEWT_VAL(BLE_HID_PHY_CODED_OPTS));
+    if (rc != 0) {
+        STATS_INC(hid_phy_stats, req_fail);
+        BLE_HID_LOG_WARN("phy request failed; rc=%d\n", rc);
+        return;
+    }
+    phy.want = want;
+}
+
+#if MYNEWT_VAL(BLE_HID_PHY_CODED_FALLBACK)
+static void
+phy_rssi_cb(struct os_event *ev)
+{
+    int8_t rssi;
+    int rc;
+
+    if (!phy.connected) {
+        return;
+    }
+
+    rc = ble_gap_conn_rssi(phy.conn_handle, &rssi);
+    if (rc == 0) {
+        /* exponential average, weight 1/4 for the new sample */
+        if (phy.rssi_avg == 0) {
+            phy.rssi_avg = rssi * 8;
+        } else {
+            phy.rssi_avg += (rssi * 8 - phy.rssi_avg) / 4;
+        }
+
+        if (phy.rssi_avg < MYNEWT_VAL(BLE_HID_PHY_CODED_RSSI) * 8) {
+            if (phy.want != BLE_GAP_LE_PHY_CODED) {
+                STATS_INC(hid_phy_stats, weak_rssi);
+            }
+            phy_request(BLE_GAP_LE_PHY_CODED);
+        } else if (phy.rssi_avg > MYNEWT_VAL(BLE_HID_PHY_2M_RSSI) * 8) {
+            phy.weak_link = false;
+            phy_request(PHY_DEFAULT);
+        }
+    }
+
+    os_callout_reset(&phy_rssi_timer,
+                     os_time_ms_to_ticks32(MYNEWT_VAL(BLE_HID_PHY_RSSI_PERIOD_MS)));
+}
+#endif
+
+void
+hid_phy_connected(uint16_t conn_handle)
+{
+    phy.conn_handle = conn_handle;
+    phy.connected = true;
+    phy.cur = BLE_GAP_LE_PHY_1M;
+    phy.want = BLE_GAP_LE_PHY_1M;
+    phy.rssi_avg = 0;
+
+#if MYNEWT_VAL(BLE_HID_PHY_CODED_FALLBACK)
+    if (phy.weak_link) {
+        STATS_INC(hid_phy_stats, weak_spvn_to);
+        phy_request(BLE_GAP_LE_PHY_CODED);
+    }
+    os_callout_reset(&phy_rssi_timer,
+                     os_time_ms_to_ticks32(MYNEWT_VAL(BLE_HID_PHY_RSSI_PERIOD_MS)));
+#endif
+
+    if (phy.want != BLE_GAP_LE_PHY_CODED) {
+        phy_request(PHY_DEFAULT);
+    }
+}
+
+void
+hid_phy_disconnected(int reason)
+{
+    phy.connected = false;
+    phy.weak_link = reason == BLE_HS_HCI_ERR(BLE_ERR_CONN_SPVN_TMO);
+#if MYNEWT_VAL(BLE_HID_PHY_CODED_FALLBACK)
+    os_callout_stop(&phy_rssi_timer);
+#endif
+}
+
+void
+hid_phy_updated(int status, uint8_t tx_phy, uint8_t rx_phy)
+{
+    if (status != 0) {
+        STATS_INC(hid_phy_stats, upd_fail);
+        /* allow the policy to ask again */
+        phy.want = phy.cur;
+        return;
+    }
+
+    if (tx_phy != phy.cur) {
+        switch (tx_phy) {
+        case BLE_GAP_LE_PHY_1M:
+            STATS_INC(hid_phy_stats, to_1m);
+            break;
+        case BLE_GAP_LE_PHY_2M:
+            STATS_INC(hid_phy_stats, to_2m);
+            break;
+        case BLE_GAP_LE_PHY_CODED:
+            STATS_INC(hid_phy_stats, to_coded);
+            break;
+        }
+    }
+    phy.cur = tx_phy;
+    BLE_HID_LOG_INFO("phy updated; tx=%d rx=%d\n", tx_phy, rx_phy);
+}
+
+void
+hid_phy_init(void)
+{
+    int rc;
+
+#if MYNEWT_VAL(BLE_HID_PHY_CODED_FALLBACK)
+    os_callout_init(&phy_rssi_timer, hid_host_evq_get(), phy_rssi_cb, NULL);
+#endif
+
+    rc = stats_init_and_reg(STATS_HDR(hid_phy_stats),
+                            STATS_SIZE_INIT_PARMS(hid_phy_stats, STATS_SIZE_32),
+                            STATS_NAME_INIT_PARMS(hid_phy_stats),
+                            "hid_phy");
+    SYSINIT_PANIC_ASSERT(rc == 0);
+}
@@ -0,0 +1,46 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_HID_PHY_
+#define H_HID_PHY_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   PHY policy.  The 2M PHY is requested after connect; the link falls back
+   to the coded PHY while the averaged RSSI is below BLE_HID_PHY_CODED_RSSI
+   or right away when the previous link was lost to a supervision timeout,
+   and returns to 2M once the RSSI is above BLE_HID_PHY_2M_RSSI.
+ */
+
+void hid_phy_init(void);
+void hid_phy_connected(uint16_t conn_handle);
+void hid_phy_disconnected(int reason);
+/* BLE_GAP_EVENT_PHY_UPDATE_COMPLETE */
+void hid_phy_updated(int status, uint8_t tx_phy, uint8_t rx_phy);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
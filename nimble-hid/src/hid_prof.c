@@ -0,0 +1,168 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "os/mynewt.h"
+#include "nimble-hid/hid_prof.h"
+
+#if MYNEWT_VAL(BLE_HID_PROF)
+
+#if MYNEWT_VAL(SHELL_TASK)
+#include <string.h>
+#include "console/console.h"
+#include "shell/shell.h"
+#endif
+
+#if MYNEWT_VAL(BLE_HID_PROF_DWT)
+#include "mcu/cmsis_nvic.h"
+#endif
+
+#include "nimble-hid/hid_trace.h"
+
+struct hid_prof_probe {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+};
+
+static struct hid_prof_probe hid_prof_probes[HID_PROF_CNT];
+
+void
+hid_prof_add(uint8_t id, uint32_t ticks)
+{
+    struct hid_prof_probe *probe = &hid_prof_probes[id];
+    os_sr_t sr;
+
+    OS_ENTER_CRITICAL(sr);
+    if (probe->count == 0 || ticks < probe->min) {
+        probe->min = ticks;
+    }
+    if (ticks > probe->max) {
+        probe->max = ticks;
+    }
+    probe->sum += ticks;
+    probe->count++;
+    OS_EXIT_CRITICAL(sr);
+}
+
+#if MYNEWT_VAL(SHELL_TASK)
+static const char * const hid_prof_names[HID_PROF_CNT] = {
+    [HID_PROF_MATRIX_SCAN]      = "matrix_scan",
+    [HID_PROF_READ_COLS]        = "read_cols",
+    [HID_PROF_KEYMAP]           = "keymap",
+    [HID_PROF_SEND_REPORT]      = "send_report",
+    [HID_PROF_GATT_READ]        = "gatt_read",
+    [HID_PROF_GATT_REPORT]      = "gatt_report",
+    [HID_PROF_GATT_CTRL]        = "gatt_ctrl",
+    [HID_PROF_TRACE]            = "trace",
+};
+
+static uint32_t
+hid_prof_ns(uint64_t ticks)
+{
+#if MYNEWT_VAL(BLE_HID_PROF_DWT)
+    return ticks * 1000 / (SystemCoreClock / 1000000);
+#else
+    return ticks * 1000000000 / MYNEWT_VAL(OS_CPUTIME_FREQ);
+#endif
+}
+
+static void
+hid_prof_dump(void)
+{
+    struct hid_prof_probe probes[HID_PROF_CNT];
+    os_sr_t sr;
+    int i;
+
+    OS_ENTER_CRITICAL(sr);
+    memcpy(probes, hid_prof_probes, sizeof(probes));
+    memset(hid_prof_probes, 0, sizeof(hid_prof_probes));
+    OS_EXIT_CRITICAL(sr);
+
+    console_printf("%-12s %8s %8s %8s %8s\n",
+                   "probe", "count", "min ns", "mean ns", "max ns");
+    for (i = 0; i < HID_PROF_CNT; ++i) {
+        if (probes[i].count == 0) {
+            continue;
+        }
+        console_printf("%-12s %8lu %8lu %8lu %8lu\n", hid_prof_names[i],
+                       (unsigned long)probes[i].count,
+                       (unsigned long)hid_prof_ns(probes[i].min),
+                       (unsigned long)hid_prof_ns(probes[i].sum / probes[i].count),
+                       (unsigned long)hid_prof_ns(probes[i].max));
+    }
+}
+
+#if MYNEWT_VAL(BLE_HID_TRACE_ENTRIES) > 0
+#define HID_PROF_TRACE_ITERS    256
+
+/* Times single trace events, interrupts left on as on the hot path */
+static void
+hid_prof_trace(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < HID_PROF_TRACE_ITERS; ++i) {
+        HID_PROF_SCOPE(HID_PROF_TRACE);
+        HID_TRACE(HID_TRACE_PROF, 0, 0, i);
+    }
+}
+#endif
+
+/*
+   "prof" prints the table and starts a new measurement.  "prof trace"
+   first records HID_PROF_TRACE_ITERS trace events under the trace probe.
+ */
+static int
+hid_prof_cli_cmd(int argc, char **argv)
+{
+#if MYNEWT_VAL(BLE_HID_TRACE_ENTRIES) > 0
+    if (argc > 1 && !strcmp(argv[1], "trace")) {
+        hid_prof_trace();
+    }
+#endif
+    hid_prof_dump();
+    return 0;
+}
+
+static struct shell_cmd hid_prof_cli = {
+    .sc_cmd = "prof",
+    .sc_cmd_func = hid_prof_cli_cmd,
+};
+#endif
+
+void
+hid_prof_init(void)
+{
+#if MYNEWT_VAL(SHELL_TASK)
+    int rc;
+#endif
+
+#if MYNEWT_VAL(BLE_HID_PROF_DWT)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+#if MYNEWT_VAL(SHELL_TASK)
+    rc = shell_cmd_register(&hid_prof_cli);
+    SYSINIT_PANIC_ASSERT(rc == 0);
+#endif
+}
+
+#endif
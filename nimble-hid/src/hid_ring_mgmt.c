@@ -0,0 +1,123 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "os/mynewt.h"
+
+#if MYNEWT_VAL(BLE_HID_TRACE_MGMT) || MYNEWT_VAL(BLE_HID_HLOG_MGMT)
+
+#include <string.h>
+#include "cborattr/cborattr.h"
+#include "hid_ring_mgmt.h"
+
+static uint32_t
+hid_ring_mgmt_first(const struct hid_ring_mgmt *rm, uint32_t head)
+{
+    return head > rm->entries ? head - rm->entries : 0;
+}
+
+int
+hid_ring_mgmt_read(struct mgmt_ctxt *ctxt, const struct hid_ring_mgmt *rm)
+{
+    uint8_t *chunk = rm->chunk;
+    uint64_t off = 0;
+    uint32_t head;
+    uint32_t first;
+    uint32_t cnt;
+    CborError err = 0;
+    int rc;
+
+    const struct cbor_attr_t attrs[] = {
+        {
+            .attribute = "off",
+            .type = CborAttrUnsignedIntegerType,
+            .addr.uinteger = &off,
+            .nodefault = true,
+        },
+        { 0 },
+    };
+
+    rc = cbor_read_object(&ctxt->it, attrs);
+    if (rc != 0) {
+        return MGMT_ERR_EINVAL;
+    }
+
+    head = __atomic_load_n(rm->head, __ATOMIC_RELAXED);
+    first = hid_ring_mgmt_first(rm, head);
+    if (off < first) {
+        off = first;
+    }
+    if (off > head) {
+        off = head;
+    }
+
+    cnt = head - off;
+    if (cnt > rm->chunk_max) {
+        cnt = rm->chunk_max;
+    }
+    for (uint32_t i = 0; i < cnt; ++i) {
+        memcpy(chunk + i * rm->rec_size,
+               (const uint8_t *)rm->ring + ((off + i) % rm->entries) * rm->rec_size,
+               rm->rec_size);
+    }
+
+    /* drop the records the writers lapped while copying */
+    head = __atomic_load_n(rm->head, __ATOMIC_RELAXED);
+    first = hid_ring_mgmt_first(rm, head);
+    if (off < first) {
+        uint32_t lost = first - off;
+
+        lost = lost > cnt ? cnt : lost;
+        cnt -= lost;
+        memmove(chunk, chunk + lost * rm->rec_size, cnt * rm->rec_size);
+        off += lost;
+    }
+
+    err |= cbor_encode_text_stringz(&ctxt->encoder, "rc");
+    err |= cbor_encode_int(&ctxt->encoder, MGMT_ERR_EOK);
+    err |= cbor_encode_text_stringz(&ctxt->encoder, "off");
+    err |= cbor_encode_uint(&ctxt->encoder, off);
+    err |= cbor_encode_text_stringz(&ctxt->encoder, "next");
+    err |= cbor_encode_uint(&ctxt->encoder, off + cnt);
+    err |= cbor_encode_text_stringz(&ctxt->encoder, "tps");
+    err |= cbor_encode_uint(&ctxt->encoder, MYNEWT_VAL(OS_CPUTIME_FREQ));
+    err |= cbor_encode_text_stringz(&ctxt->encoder, "d");
+    err |= cbor_encode_byte_string(&ctxt->encoder, chunk, cnt * rm->rec_size);
+    if (err != 0) {
+        return MGMT_ERR_ENOMEM;
+    }
+
+    return 0;
+}
+
+int
+hid_ring_mgmt_clear(struct mgmt_ctxt *ctxt, const struct hid_ring_mgmt *rm)
+{
+    CborError err;
+
+    __atomic_store_n(rm->head, 0, __ATOMIC_RELAXED);
+
+    err = cbor_encode_text_stringz(&ctxt->encoder, "rc");
+    err |= cbor_encode_int(&ctxt->encoder, MGMT_ERR_EOK);
+    if (err != 0) {
+        return MGMT_ERR_ENOMEM;
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_HID_RING_MGMT_
+#define H_HID_RING_MGMT_
+
+#include <stdint.h>
+#include "mgmt/mgmt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Paged SMP read-out of a RAM ring of fixed-size records, shared by the
+   trace and binary log groups.  head counts every record ever written,
+   the ring holds the last 'entries' of them.
+ */
+struct hid_ring_mgmt {
+    const void *ring;
+    uint32_t *head;
+    void *chunk;        /* scratch for one response, chunk_max records */
+    uint16_t rec_size;
+    uint16_t entries;
+    uint16_t chunk_max;
+};
+
+/*
+   Read request: {"off": <record index>}
+   Response: {"rc": 0, "off": <index of the first returned record>,
+              "next": <index to request next>, "tps": <cputime ticks/s>,
+              "d": <packed record array>}
+   "off" is moved forward when the requested records were overwritten,
+   the client keeps reading until "next" stops advancing.
+ */
+int hid_ring_mgmt_read(struct mgmt_ctxt *ctxt, const struct hid_ring_mgmt *rm);
+
+/* Empties the ring, the request has no arguments */
+int hid_ring_mgmt_clear(struct mgmt_ctxt *ctxt, const struct hid_ring_mgmt *rm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
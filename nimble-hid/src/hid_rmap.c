@@ -0,0 +1,338 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <string.h>
+
+#include "defs/error.h"
+#include "hid_rmap.h"
+
+/* Item types */
+#define ITEM_TYPE_MAIN          0
+#define ITEM_TYPE_GLOBAL        1
+#define ITEM_TYPE_LOCAL         2
+
+/* Main item tags */
+#define MAIN_INPUT              0x8
+#define MAIN_OUTPUT             0x9
+#define MAIN_COLLECTION         0xA
+#define MAIN_FEATURE            0xB
+#define MAIN_END_COLLECTION     0xC
+
+/* Global item tags */
+#define GLOBAL_USAGE_PAGE       0x0
+#define GLOBAL_REPORT_SIZE      0x7
+#define GLOBAL_REPORT_ID        0x8
+#define GLOBAL_REPORT_COUNT     0x9
+#define GLOBAL_PUSH             0xA
+#define GLOBAL_POP              0xB
+
+/* Local item tags */
+#define LOCAL_USAGE             0x0
+
+#define LONG_ITEM_PREFIX        0xFE
+#define COLLECTION_APPLICATION  0x01
+
+#define USAGE_PAGE_GENERIC_DESKTOP  0x01
+#define USAGE_MOUSE                 0x02
+#define USAGE_KEYBOARD              0x06
+
+#define BOOT_KBD_IN_BITS        64
+#define BOOT_KBD_OUT_BITS       8
+#define BOOT_MOUSE_IN_BITS      24
+
+/* report types map to HID_REPORT_TYPE_* - 1 */
+#define RPT_IN                  0
+#define RPT_OUT                 1
+#define RPT_FEATURE             2
+
+static const uint8_t short_item_size[4] = { 0, 1, 2, 4 };
+
+static struct hid_rmap_report *
+hid_rmap_get_report(struct hid_rmap_parser *p, uint8_t id)
+{
+    struct hid_rmap_info *info = p->info;
+
+    for (int i = 0; i < info->num_reports; ++i) {
+        if (info->reports[i].id == id) {
+            return &info->reports[i];
+        }
+    }
+
+    if (info->num_reports >= MYNEWT_VAL(BLE_HID_RMAP_MAX_REPORTS)) {
+        p->error = SYS_ENOMEM;
+        return NULL;
+    }
+
+    struct hid_rmap_report *rpt = &info->reports[info->num_reports++];
+    memset(rpt, 0, sizeof(*rpt));
+    rpt->id = id;
+    return rpt;
+}
+
+static void
+hid_rmap_main_data(struct hid_rmap_parser *p, int type)
+{
+    struct hid_rmap_report *rpt;
+    uint32_t bits;
+
+    if (p->global.report_id) {
+        p->has_report_id = 1;
+    } else {
+        p->has_no_report_id = 1;
+    }
+    if (p->has_report_id && p->has_no_report_id) {
+        /* either every report has an ID or none has */
+        p->error = SYS_EINVAL;
+        return;
+    }
+
+    rpt = hid_rmap_get_report(p, p->global.report_id);
+    if (rpt == NULL) {
+        return;
+    }
+    if (!rpt->app_usage_page && !rpt->app_usage) {
+        rpt->app_usage_page = p->app_usage_page;
+        rpt->app_usage = p->app_usage;
+    }
+
+    bits = rpt->bits[type] + (uint32_t)p->global.report_size * p->global.report_count;
+    if (bits > UINT16_MAX) {
+        p->error = SYS_ERANGE;
+        return;
+    }
+    rpt->bits[type] = bits;
+}
+
+static void
+hid_rmap_item(struct hid_rmap_parser *p, uint8_t prefix, uint32_t val)
+{
+    uint8_t tag = prefix >> 4;
+    uint8_t type = (prefix >> 2) & 0x03;
+
+    switch (type) {
+    case ITEM_TYPE_MAIN:
+        switch (tag) {
+        case MAIN_INPUT:
+            hid_rmap_main_data(p, RPT_IN);
+            break;
+        case MAIN_OUTPUT:
+            hid_rmap_main_data(p, RPT_OUT);
+            break;
+        case MAIN_FEATURE:
+            hid_rmap_main_data(p, RPT_FEATURE);
+            break;
+        case MAIN_COLLECTION:
+            if (p->collection_depth == 0 && val == COLLECTION_APPLICATION) {
+                p->app_usage_page = p->global.usage_page;
+                p->app_usage = p->local_usage;
+            }
+            p->collection_depth++;
+            break;
+        case MAIN_END_COLLECTION:
+            if (p->collection_depth == 0) {
+                p->error = SYS_EINVAL;
+                break;
+            }
+            p->collection_depth--;
+            break;
+        default:
+            p->error = SYS_EINVAL;
+            break;
+        }
+        /* local items only apply to the following main item */
+        p->local_usage = 0;
+        break;
+
+    case ITEM_TYPE_GLOBAL:
+        switch (tag) {
+        case GLOBAL_USAGE_PAGE:
+            p->global.usage_page = val;
+            break;
+        case GLOBAL_REPORT_SIZE:
+            p->global.report_size = val;
+            break;
+        case GLOBAL_REPORT_COUNT:
+            p->global.report_count = val;
+            break;
+        case GLOBAL_REPORT_ID:
+            if (val == 0 || val > UINT8_MAX) {
+                p->error = SYS_EINVAL;
+                break;
+            }
+            p->global.report_id = val;
+            break;
+        case GLOBAL_PUSH:
+            if (p->stack_depth >= HID_RMAP_STACK_DEPTH) {
+                p->error = SYS_ENOMEM;
+                break;
+            }
+            p->stack[p->stack_depth++] = p->global;
+            break;
+        case GLOBAL_POP:
+            if (p->stack_depth == 0) {
+                p->error = SYS_EINVAL;
+                break;
+            }
+            p->global = p->stack[--p->stack_depth];
+            break;
+        default:
+            /* logical/physical ranges and units do not change sizes */
+            break;
+        }
+        break;
+
+    case ITEM_TYPE_LOCAL:
+        if (tag == LOCAL_USAGE && !p->local_usage) {
+            /* extended usages carry the usage page in the high half */
+            p->local_usage = val & 0xFFFF;
+        }
+        break;
+
+    default:
+        /* reserved item type */
+        p->error = SYS_EINVAL;
+        break;
+    }
+}
+
+void
+hid_rmap_parser_init(struct hid_rmap_parser *p, struct hid_rmap_info *info)
+{
+    memset(p, 0, sizeof(*p));
+    memset(info, 0, sizeof(*info));
+    p->info = info;
+}
+
+int
+hid_rmap_parser_feed(struct hid_rmap_parser *p, const uint8_t *data, size_t len)
+{
+    const uint8_t *end = data + len;
+
+    while (data < end && !p->error) {
+        if (p->long_skip) {
+            size_t n = end - data;
+
+            if (n > p->long_skip) {
+                n = p->long_skip;
+            }
+            p->long_skip -= n;
+            data += n;
+            continue;
+        }
+
+        if (p->item_len == 0) {
+            p->item_need = (*data == LONG_ITEM_PREFIX) ?
+                           3 : 1 + short_item_size[*data & 0x03];
+        }
+
+        while (p->item_len < p->item_need && data < end) {
+            p->item[p->item_len++] = *data++;
+        }
+        if (p->item_len < p->item_need) {
+            /* item continues in the next chunk */
+            break;
+        }
+
+        if (p->item[0] == LONG_ITEM_PREFIX) {
+            /* no long items are defined, skip the data */
+            p->long_skip = p->item[1];
+        } else {
+            uint32_t val = 0;
+
+            for (int i = p->item_len - 1; i > 0; --i) {
+                val = (val << 8) | p->item[i];
+            }
+            hid_rmap_item(p, p->item[0], val);
+        }
+        p->item_len = 0;
+    }
+
+    return p->error;
+}
+
+int
+hid_rmap_parser_finish(struct hid_rmap_parser *p)
+{
+    struct hid_rmap_info *info = p->info;
+
+    if (p->error) {
+        return p->error;
+    }
+    if (p->item_len || p->long_skip || p->collection_depth) {
+        /* truncated item or unbalanced collections */
+        return SYS_EINVAL;
+    }
+
+    for (int i = 0; i < info->num_reports; ++i) {
+        struct hid_rmap_report *rpt = &info->reports[i];
+
+        for (int t = RPT_IN; t <= RPT_FEATURE; ++t) {
+            if (rpt->bits[t] % 8) {
+                /* BLE HID reports are transferred as whole bytes */
+                return SYS_EINVAL;
+            }
+        }
+
+        if (rpt->app_usage_page != USAGE_PAGE_GENERIC_DESKTOP) {
+            continue;
+        }
+        if (rpt->app_usage == USAGE_KEYBOARD &&
+            rpt->bits[RPT_IN] == BOOT_KBD_IN_BITS &&
+            rpt->bits[RPT_OUT] <= BOOT_KBD_OUT_BITS) {
+            rpt->boot_flags |= HID_RMAP_BOOT_KBD;
+        }
+        if (rpt->app_usage == USAGE_MOUSE &&
+            rpt->bits[RPT_IN] >= BOOT_MOUSE_IN_BITS) {
+            rpt->boot_flags |= HID_RMAP_BOOT_MOUSE;
+        }
+    }
+
+    return 0;
+}
+
+int
+hid_rmap_parse(const uint8_t *map, size_t len, struct hid_rmap_info *info)
+{
+    struct hid_rmap_parser p;
+
+    hid_rmap_parser_init(&p, info);
+    hid_rmap_parser_feed(&p, map, len);
+    return hid_rmap_parser_finish(&p);
+}
+
+const struct hid_rmap_report *
+hid_rmap_find(const struct hid_rmap_info *info, uint8_t id)
+{
+    for (int i = 0; i < info->num_reports; ++i) {
+        if (info->reports[i].id == id) {
+            return &info->reports[i];
+        }
+    }
+    return NULL;
+}
+
+int
+hid_rmap_report_len(const struct hid_rmap_info *info, uint8_t id, uint8_t type)
+{
+    const struct hid_rmap_report *rpt = hid_rmap_find(info, id);
+
+    if (rpt == NULL || type < 1 || type > 3 || rpt->bits[type - 1] == 0) {
+        return -1;
+    }
+    return rpt->bits[type - 1] / 8;
+}
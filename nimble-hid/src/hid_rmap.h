@@ -0,0 +1,102 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_HID_RMAP_
+#define H_HID_RMAP_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "syscfg/syscfg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Boot protocol compatibility flags of a report ID */
+#define HID_RMAP_BOOT_KBD               0x01
+#define HID_RMAP_BOOT_MOUSE             0x02
+
+/* Maximum nesting of Push items */
+#define HID_RMAP_STACK_DEPTH            4
+
+/* Sizes of one report ID, indexed by HID_REPORT_TYPE_* - 1 */
+struct hid_rmap_report {
+    uint8_t id;
+    uint8_t boot_flags;
+    /* Usage of the application collection the report was declared in */
+    uint16_t app_usage_page;
+    uint16_t app_usage;
+    uint16_t bits[3];
+};
+
+struct hid_rmap_info {
+    struct hid_rmap_report reports[MYNEWT_VAL(BLE_HID_RMAP_MAX_REPORTS)];
+    uint8_t num_reports;
+};
+
+struct hid_rmap_global {
+    uint16_t usage_page;
+    uint8_t report_id;
+    uint16_t report_size;
+    uint16_t report_count;
+};
+
+/*
+   Streaming parser state.  The descriptor can be fed in chunks of any
+   size (e.g. as it arrives from a long write), items split across chunk
+   boundaries are reassembled in 'item'.
+ */
+struct hid_rmap_parser {
+    struct hid_rmap_info *info;
+    struct hid_rmap_global global;
+    struct hid_rmap_global stack[HID_RMAP_STACK_DEPTH];
+    uint8_t stack_depth;
+    uint8_t collection_depth;
+    /* first usage seen since the last main item */
+    uint16_t local_usage;
+    uint16_t app_usage_page;
+    uint16_t app_usage;
+    /* bytes of a long item still to skip */
+    uint16_t long_skip;
+    uint8_t item[5];
+    uint8_t item_len;
+    uint8_t item_need;
+    uint8_t has_report_id;
+    uint8_t has_no_report_id;
+    int error;
+};
+
+void hid_rmap_parser_init(struct hid_rmap_parser *p, struct hid_rmap_info *info);
+int hid_rmap_parser_feed(struct hid_rmap_parser *p, const uint8_t *data, size_t len);
+int hid_rmap_parser_finish(struct hid_rmap_parser *p);
+
+/* Parse a whole descriptor in one go */
+int hid_rmap_parse(const uint8_t *map, size_t len, struct hid_rmap_info *info);
+
+const struct hid_rmap_report *hid_rmap_find(const struct hid_rmap_info *info,
+                                            uint8_t id);
+
+/* Length in bytes of report (id, type) without the report ID prefix, -1 if not declared */
+int hid_rmap_report_len(const struct hid_rmap_info *info, uint8_t id, uint8_t type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
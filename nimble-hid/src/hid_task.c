@@ -0,0 +1,103 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <assert.h>
+
+#include "os/mynewt.h"
+#include "host/ble_hs.h"
+#include "hid_task.h"
+
+static struct os_task hid_task;
+static os_stack_t hid_task_stack[MYNEWT_VAL(BLE_HID_TASK_STACK_SIZE)];
+static struct os_eventq hid_evq;
+
+static struct os_task hid_host_task;
+static os_stack_t hid_host_task_stack[MYNEWT_VAL(BLE_HID_HOST_TASK_STACK_SIZE)];
+static struct ble_npl_eventq hid_host_evq;
+static struct os_event hid_host_start_ev;
+
+static void
+hid_task_handler(void *arg)
+{
+    struct os_eventq *evq = arg;
+
+    while (1) {
+        os_eventq_run(evq);
+    }
+}
+
+struct os_eventq *
+hid_evq_get(void)
+{
+    return &hid_evq;
+}
+
+struct os_eventq *
+hid_host_evq_get(void)
+{
+    return &hid_host_evq.evq;
+}
+
+/*
+   Takes the place of BLE_HS_AUTO_START.  Posted to the default queue so
+   it runs once sysinit is done, then moved to the host task: the host
+   binds its timer to the host queue and records the host task as its
+   parent when it starts.
+ */
+static void
+hid_host_start(struct os_event *ev)
+{
+    int rc;
+
+    if (os_sched_get_current_task() != &hid_host_task) {
+        os_eventq_put(&hid_host_evq.evq, ev);
+        return;
+    }
+
+    /* in case ble_hs_init() fell back to the default queue */
+    ble_hs_evq_set(&hid_host_evq);
+    rc = ble_hs_start();
+    assert(rc == 0);
+}
+
+/* sysinit, ahead of ble_hs_init() */
+void
+hid_task_init(void)
+{
+    int rc;
+
+    os_eventq_init(&hid_evq);
+    rc = os_task_init(&hid_task, "hid", hid_task_handler, &hid_evq,
+                      MYNEWT_VAL(BLE_HID_TASK_PRIO), OS_WAIT_FOREVER,
+                      hid_task_stack, MYNEWT_VAL(BLE_HID_TASK_STACK_SIZE));
+    SYSINIT_PANIC_ASSERT(rc == 0);
+
+    /* set before ble_hs_init() so nothing of the host is bound to the
+     * default queue
+     */
+    ble_npl_eventq_init(&hid_host_evq);
+    rc = os_task_init(&hid_host_task, "ble_hs", hid_task_handler,
+                      &hid_host_evq.evq, MYNEWT_VAL(BLE_HID_HOST_TASK_PRIO),
+                      OS_WAIT_FOREVER, hid_host_task_stack,
+                      MYNEWT_VAL(BLE_HID_HOST_TASK_STACK_SIZE));
+    SYSINIT_PANIC_ASSERT(rc == 0);
+    ble_hs_evq_set(&hid_host_evq);
+
+    hid_host_start_ev.ev_cb = hid_host_start;
+    os_eventq_put(os_eventq_dflt_get(), &hid_host_start_ev);
+}
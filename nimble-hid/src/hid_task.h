@@ -0,0 +1,53 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_HID_TASK_
+#define H_HID_TASK_
+
+#include "os/os.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+   Event queues of the HID package, each drained by its own task so the
+   console, shell and SMP work left on the default queue cannot delay
+   them:
+
+   hid_evq_get()       report pipeline (pending replay, send benchmark),
+                       BLE_HID_TASK_PRIO
+   hid_host_evq_get()  NimBLE host and the link policies driven from GAP
+                       events (connection parameters, PHY, host switch),
+                       BLE_HID_HOST_TASK_PRIO
+
+   The matrix scan runs in the tmk task, whose priority should be above
+   both.  hid_task_init() runs from sysinit ahead of ble_hs_init() and
+   starts the host in its task once sysinit is done.
+ */
+
+void hid_task_init(void);
+struct os_eventq *hid_evq_get(void);
+struct os_eventq *hid_host_evq_get(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
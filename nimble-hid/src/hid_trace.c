@@ -0,0 +1,90 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "os/mynewt.h"
+#include "nimble-hid/hid_trace.h"
+
+#if MYNEWT_VAL(BLE_HID_TRACE_ENTRIES) > 0
+
+#if MYNEWT_VAL(BLE_HID_TRACE_MGMT)
+#include "hid_ring_mgmt.h"
+#endif
+
+#define HID_TRACE_ENTRIES MYNEWT_VAL(BLE_HID_TRACE_ENTRIES)
+
+struct hid_trace_rec hid_trace_ring[HID_TRACE_ENTRIES];
+uint32_t hid_trace_head;
+
+#if MYNEWT_VAL(BLE_HID_TRACE_MGMT)
+
+/* Command IDs of the trace group */
+#define HID_TRACE_MGMT_ID_READ      0
+#define HID_TRACE_MGMT_ID_CLEAR     1
+
+#define HID_TRACE_MGMT_CHUNK        MYNEWT_VAL(BLE_HID_TRACE_MGMT_CHUNK)
+
+static struct hid_trace_rec hid_trace_chunk[HID_TRACE_MGMT_CHUNK];
+
+static const struct hid_ring_mgmt hid_trace_mgmt_ring = {
+    .ring = hid_trace_ring,
+    .head = &hid_trace_head,
+    .chunk = hid_trace_chunk,
+    .rec_size = sizeof(hid_trace_chunk[0]),
+    .entries = HID_TRACE_ENTRIES,
+    .chunk_max = HID_TRACE_MGMT_CHUNK,
+};
+
+static int
+hid_trace_mgmt_read(struct mgmt_ctxt *ctxt)
+{
+    return hid_ring_mgmt_read(ctxt, &hid_trace_mgmt_ring);
+}
+
+static int
+hid_trace_mgmt_clear(struct mgmt_ctxt *ctxt)
+{
+    return hid_ring_mgmt_clear(ctxt, &hid_trace_mgmt_ring);
+}
+
+static const struct mgmt_handler hid_trace_mgmt_handlers[] = {
+    [HID_TRACE_MGMT_ID_READ] = {
+        .mh_read = hid_trace_mgmt_read,
+        .mh_write = NULL,
+    },
+    [HID_TRACE_MGMT_ID_CLEAR] = {
+        .mh_read = NULL,
+        .mh_write = hid_trace_mgmt_clear,
+    },
+};
+
+static struct mgmt_group hid_trace_mgmt_group = {
+    .mg_handlers = hid_trace_mgmt_handlers,
+    .mg_handlers_count = sizeof(hid_trace_mgmt_handlers) / sizeof(hid_trace_mgmt_handlers[0]),
+    .mg_group_id = MYNEWT_VAL(BLE_HID_TRACE_MGMT_GROUP),
+};
+#endif
+
+void
+hid_trace_init(void)
+{
+#if MYNEWT_VAL(BLE_HID_TRACE_MGMT)
+    mgmt_register_group(&hid_trace_mgmt_group);
+#endif
+}
+
+#endif
@@ -17,22 +17,113 @@
  * under the License.
  */
 
+#include "defs/error.h"
+#include "stats/stats.h"
 #include "gatt_svr.h"
+#include "gatt_cache.h"
+#include "hid_conn_gov.h"
+#include "hid_bond.h"
+#include "hid_phy.h"
+#include "hid_task.h"
 #include "assert.h"
 #include "hid_func.h"
+#include "hid_log.h"
+#include "nimble-hid/hid_anchor.h"
+#include "nimble-hid/hid_prof.h"
+#include "nimble-hid/hid_trace.h"
+#include "nimble-hid/nimble-hid.h"
 #include "logcfg/logcfg.h"
 
 #define MACSTR "%02x%02x%02x%02x%02x%02x"
 #define MAC2STR_REV(a) (a)[5], (a)[4], (a)[3], (a)[2], (a)[1], (a)[0]
 
 static void bleprph_advertise(void);
+static void bleprph_adv_start(int phase);
 static void bleprph_on_reset(int reason);
 static void bleprph_print_conn_desc(struct ble_gap_conn_desc *desc);
 static int bleprph_gap_event(struct ble_gap_event *event, void *arg);
 static void bleprph_on_sync(void);
-static int user_parse(const struct ble_hs_adv_field *data, void *arg);
 static uint8_t own_addr_type;
 
+/*
+   Reconnect phases.  Each phase but the last ends with an advertise
+   complete event, which moves on to the next one: a host timeout, or for
+   high duty directed advertising the controller's own 1.28 s limit.  The
+   directed phases are skipped when no bonded host is known.
+ */
+enum bleprph_adv_phase {
+    ADV_PHASE_HD_DIRECTED,
+    ADV_PHASE_LD_DIRECTED,
+    ADV_PHASE_FAST,
+    ADV_PHASE_SLOW,
+};
+
+STATS_SECT_START(hid_link_stats)
+    STATS_SECT_ENTRY(connect)
+    STATS_SECT_ENTRY(connect_fail)
+    STATS_SECT_ENTRY(reconnect)
+    STATS_SECT_ENTRY(disconnect)
+    STATS_SECT_ENTRY(spvn_to)
+    STATS_SECT_ENTRY(conn_update)
+    STATS_SECT_ENTRY(mtu_change)
+    STATS_SECT_ENTRY(phy_change)
+    STATS_SECT_ENTRY(enc_change)
+STATS_SECT_END
+
+STATS_NAME_START(hid_link_stats)
+    STATS_NAME(hid_link_stats, connect)
+    STATS_NAME(hid_link_stats, connect_fail)
+    STATS_NAME(hid_link_stats, reconnect)
+    STATS_NAME(hid_link_stats, disconnect)
+    STATS_NAME(hid_link_stats, spvn_to)
+    STATS_NAME(hid_link_stats, conn_update)
+    STATS_NAME(hid_link_stats, mtu_change)
+    STATS_NAME(hid_link_stats, phy_change)
+    STATS_NAME(hid_link_stats, enc_change)
+STATS_NAME_END(hid_link_stats)
+
+static STATS_SECT_DECL(hid_link_stats) hid_link_stats;
+
+static uint8_t adv_phase;
+static os_time_t adv_start_time;
+
+static uint16_t bleprph_conn_handle = BLE_HS_CONN_HANDLE_NONE;
+static bool bleprph_connected_once;
+
+/* host switch requested by ble_hid_host_switch(), run on the host queue */
+enum bleprph_switch_op {
+    SWITCH_OP_SWITCH,
+    SWITCH_OP_PAIR,
+    SWITCH_OP_UNPAIR,
+};
+
+static struct os_event bleprph_switch_ev;
+static int bleprph_switch_slot;
+static uint8_t bleprph_switch_op;
+/* cputime of the last switch until its host is back, 0 if none */
+static uint32_t bleprph_switch_ts;
+
+/* going to System OFF, the link stays down */
+static bool bleprph_sleeping;
+#if MYNEWT_VAL(BLE_HID_RETAIN)
+static struct os_event bleprph_sleep_ev;
+/* released once the link is down */
+static struct os_sem bleprph_sleep_sem;
+#endif
+
+/* room for the name in the scan response, after field length and type */
+#define ADV_NAME_MAX_LEN    (BLE_HS_ADV_MAX_SZ - 2)
+
+/* raw payloads of the undirected phases, see bleprph_adv_set_data() */
+static uint8_t adv_data[BLE_HS_ADV_MAX_SZ];
+static uint8_t adv_data_len;
+static uint8_t adv_rsp_data[BLE_HS_ADV_MAX_SZ];
+static uint8_t adv_rsp_data_len;
+static size_t adv_name_len;
+static uint16_t adv_appearance;
+/* the controller holds the cached payloads */
+static bool adv_data_set;
+
 /**
  * Logs information about a connection.
  */
@@ -62,11 +153,14 @@ bleprph_print_conn_desc(struct ble_gap_conn_desc *desc)
 }
 
 static int
-user_parse(const struct ble_hs_adv_field *data, void *arg)
+bleprph_on_mtu(uint16_t conn_handle, const struct ble_gatt_error *error,
+               uint16_t mtu, void *arg)
 {
-    BLE_HID_LOG_INFO("Parse data: field len %d, type %x, total %d bytes\n",
-        data->length, data->type, data->length + 2); /* first byte type and second byte length */
-    return 1;
+    if (error->status != 0) {
+        BLE_HID_LOG_WARN("mtu exchange failed; conn_handle=%d status=%d\n",
+                         conn_handle, error->status);
+    }
+    return 0;
 }
 
 /**
@@ -87,6 +181,7 @@ static int
 bleprph_gap_event(struct ble_gap_event *event, void *arg)
 {
     struct ble_gap_conn_desc desc;
+    int slot;
     int rc;
 
     switch (event->type) {
@@ -95,13 +190,46 @@ bleprph_gap_event(struct ble_gap_event *event, void *arg)
         BLE_HID_LOG_INFO("connection %s; status=%d\n",
                 event->connect.status == 0 ? "established" : "failed",
                 event->connect.status);
+        HID_TRACE(HID_TRACE_CONNECT, event->connect.status,
+                  event->connect.conn_handle, 0);
         if (event->connect.status == 0) {
+            if (bleprph_connected_once) {
+                STATS_INC(hid_link_stats, reconnect);
+            }
+            bleprph_connected_once = true;
+            STATS_INC(hid_link_stats, connect);
             rc = ble_gap_conn_find(event->connect.conn_handle, &desc);
             assert(rc == 0);
             bleprph_print_conn_desc(&desc);
 
+            BLE_HID_LOG_INFO("connected in adv phase %d after %lu ms\n", adv_phase,
+                             (unsigned long)os_time_ticks_to_ms32(os_time_get() - adv_start_time));
+
+            bleprph_conn_handle = event->connect.conn_handle;
+            if (bleprph_sleeping) {
+                /* raced with ble_hid_sleep() stopping advertising */
+                ble_gap_terminate(bleprph_conn_handle, BLE_ERR_REM_USER_CONN_TERM);
+                return 0;
+            }
             hid_clean_vars(&desc);
+            hid_conn_gov_connected(event->connect.conn_handle);
+            hid_phy_connected(event->connect.conn_handle);
+            hid_anchor_connected(desc.conn_itvl, desc.conn_latency);
+
+#if MYNEWT_VAL(BLE_HID_CONN_MTU_EXCHANGE)
+            /* Raise the ATT MTU before the host starts discovery so the
+             * report map and DIS strings are read in one go instead of
+             * 22 byte read blobs.  The data length update is started by
+             * the controller (BLE_LL_CONN_INIT_MAX_TX_BYTES).
+             */
+            rc = ble_gattc_exchange_mtu(event->connect.conn_handle,
+                                        bleprph_on_mtu, NULL);
+            if (rc != 0) {
+                BLE_HID_LOG_WARN("mtu exchange not started; rc=%d\n", rc);
+            }
+#endif
         } else {
+            STATS_INC(hid_link_stats, connect_fail);
             /* Connection failed; resume advertising. */
             bleprph_advertise();
         }
@@ -109,10 +237,34 @@ bleprph_gap_event(struct ble_gap_event *event, void *arg)
 
     case BLE_GAP_EVENT_DISCONNECT:
         BLE_HID_LOG_INFO("disconnect; reason=%d\n", event->disconnect.reason);
+        STATS_INC(hid_link_stats, disconnect);
+        if (event->disconnect.reason == BLE_HS_HCI_ERR(BLE_ERR_CONN_SPVN_TMO)) {
+            STATS_INC(hid_link_stats, spvn_to);
+            HID_TRACE(HID_TRACE_SUPERVISION_TO, 0,
+                      event->disconnect.conn.conn_handle, 0);
+        } else {
+            HID_TRACE(HID_TRACE_DISCONNECT, 0, event->disconnect.conn.conn_handle,
+                      event->disconnect.reason);
+        }
+        bleprph_conn_handle = BLE_HS_CONN_HANDLE_NONE;
         hid_set_disconnected();
+        hid_conn_gov_disconnected();
+        hid_phy_disconnected(event->disconnect.reason);
+        hid_anchor_disconnected();
+        gatt_cache_conn_closed(event->disconnect.conn.conn_handle);
+
+#if MYNEWT_VAL(BLE_HID_RETAIN)
+        if (bleprph_sleeping) {
+            hid_bond_save_active();
+            os_sem_release(&bleprph_sleep_sem);
+            return 0;
+        }
+#endif
 
         /* Connection terminated; resume advertising. */
         bleprph_advertise();
+        /* a host switch is persisted once advertising to the new host runs */
+        hid_bond_save_active();
         return 0;
 
     case BLE_GAP_EVENT_CONN_UPDATE_REQ:
@@ -124,42 +276,88 @@ bleprph_gap_event(struct ble_gap_event *event, void *arg)
         /* The central has updated the connection parameters. */
         BLE_HID_LOG_INFO("connection updated; status=%d \n",
                    event->conn_update.status);
+        if (event->conn_update.status == 0) {
+            STATS_INC(hid_link_stats, conn_update);
+        }
+        if (ble_gap_conn_find(event->conn_update.conn_handle, &desc) == 0) {
+            HID_TRACE(HID_TRACE_CONN_UPDATE, event->conn_update.status,
+                      desc.conn_itvl,
+                      (uint32_t)desc.conn_latency << 16 | desc.supervision_timeout);
+            if (event->conn_update.status == 0) {
+                hid_anchor_connected(desc.conn_itvl, desc.conn_latency);
+            }
+        }
+        hid_conn_gov_updated(event->conn_update.conn_handle,
+                             event->conn_update.status);
         return 0;
 
     case BLE_GAP_EVENT_ADV_COMPLETE:
         BLE_HID_LOG_INFO("advertise complete; reason=%d\n",
                     event->adv_complete.reason);
-        bleprph_advertise();
+        /* The controller ends high duty directed advertising itself
+         * after 1.28 s and the host reports that with reason 0, not as
+         * a timeout.
+         */
+        if (event->adv_complete.reason == BLE_HS_ETIMEOUT ||
+            adv_phase <= ADV_PHASE_LD_DIRECTED) {
+            bleprph_adv_start(adv_phase + 1);
+        }
         return 0;
 
     case BLE_GAP_EVENT_ENC_CHANGE:
         /* Encryption has been enabled or disabled for this connection. */
         BLE_HID_LOG_INFO("encryption change event; status=%d\n",
                 event->enc_change.status);
+        STATS_INC(hid_link_stats, enc_change);
+        if (event->enc_change.status == 0 &&
+            ble_gap_conn_find(event->enc_change.conn_handle, &desc) == 0 &&
+            desc.sec_state.bonded) {
+            if (hid_bond_link_encrypted(&desc.peer_id_addr) != 0) {
+                /* the host of another slot, or a new host while the active
+                 * slot is taken: keep the link for the active slot's host
+                 */
+                ble_gap_terminate(event->enc_change.conn_handle,
+                                  BLE_ERR_REM_USER_CONN_TERM);
+                return 0;
+            }
+            gatt_cache_bonded(event->enc_change.conn_handle, hid_bond_active_slot());
+            if (bleprph_switch_ts) {
+                HID_TRACE(HID_TRACE_HOST_SWITCH, hid_bond_active_slot(), 0, 1);
+                BLE_HID_LOG_INFO("host switch to slot %d took %lu ms\n",
+                                 hid_bond_active_slot(),
+                                 (unsigned long)os_cputime_ticks_to_usecs(
+                                     os_cputime_get32() - bleprph_switch_ts) / 1000);
+                bleprph_switch_ts = 0;
+            }
+        }
         return 0;
 
     case BLE_GAP_EVENT_SUBSCRIBE:
-        BLE_HID_LOG_INFO("subscribe event; conn_handle=%d attr_handle=%04X\n"
-                    "reason=%d prev_notify=%d cur_notify=%d prev_indicate=%d cur_indicate=%d\n",
-                    event->subscribe.conn_handle,
-                    event->subscribe.attr_handle,
-                    event->subscribe.reason,
-                    event->subscribe.prev_notify,
-                    event->subscribe.cur_notify,
-                    event->subscribe.prev_indicate,
-                    event->subscribe.cur_indicate);
+        HID_HLOG_INFO(HID_LOG_SUBSCRIBE, event->subscribe.attr_handle,
+                      event->subscribe.reason,
+                      (event->subscribe.prev_notify << 3) |
+                      (event->subscribe.cur_notify << 2) |
+                      (event->subscribe.prev_indicate << 1) |
+                      event->subscribe.cur_indicate);
 
         hid_set_notify(event->subscribe.attr_handle,
             event->subscribe.cur_notify,
             event->subscribe.cur_indicate);
+        gatt_cache_subscribe(event->subscribe.conn_handle,
+                             event->subscribe.attr_handle,
+                             event->subscribe.cur_indicate);
         return 0;
 
     case BLE_GAP_EVENT_NOTIFY_TX:
-        BLE_HID_LOG_INFO("notify event; status=%d conn_handle=%d attr_handle=%04X type=%s\n",
-                    event->notify_tx.status,
-                    event->notify_tx.conn_handle,
-                    event->notify_tx.attr_handle,
-                    event->notify_tx.indication?"indicate":"notify");
+        HID_HLOG_DEBUG(HID_LOG_NOTIFY_TX, event->notify_tx.attr_handle,
+                       event->notify_tx.status, event->notify_tx.indication);
+        HID_TRACE(HID_TRACE_NOTIFY_TX, event->notify_tx.status,
+                  event->notify_tx.attr_handle, event->notify_tx.indication);
+        hid_notify_tx_done(event->notify_tx.attr_handle, event->notify_tx.status,
+                           event->notify_tx.indication);
+        gatt_cache_notify_tx(event->notify_tx.conn_handle,
+                             event->notify_tx.attr_handle,
+                             event->notify_tx.status);
         return 0;
 
     case BLE_GAP_EVENT_MTU:
@@ -167,17 +365,35 @@ bleprph_gap_event(struct ble_gap_event *event, void *arg)
                     event->mtu.conn_handle,
                     event->mtu.channel_id,
                     event->mtu.value);
+        STATS_INC(hid_link_stats, mtu_change);
+        return 0;
+
+    case BLE_GAP_EVENT_PHY_UPDATE_COMPLETE:
+        if (event->phy_updated.status == 0) {
+            STATS_INC(hid_link_stats, phy_change);
+        }
+        hid_phy_updated(event->phy_updated.status, event->phy_updated.tx_phy,
+                        event->phy_updated.rx_phy);
         return 0;
 
     case BLE_GAP_EVENT_REPEAT_PAIRING:
         /* We already have a bond with the peer, but it is attempting to
          * establish a new secure link.  This app sacrifices security for
-         * convenience: just throw away the old bond and accept the new link.
+         * convenience: just throw away the old bond and accept the new link,
+         * unless the bond belongs to the host of another slot.
          */
-
-        /* Delete the old bond. */
         rc = ble_gap_conn_find(event->repeat_pairing.conn_handle, &desc);
         assert(rc == 0);
+        slot = hid_bond_find(&desc.peer_id_addr);
+        if (slot >= 0 && slot != hid_bond_active_slot()) {
+            BLE_HID_LOG_INFO("host of slot %d re-pairing while slot %d is active\n",
+                             slot, hid_bond_active_slot());
+            ble_gap_terminate(event->repeat_pairing.conn_handle,
+                              BLE_ERR_REM_USER_CONN_TERM);
+            return BLE_GAP_REPEAT_PAIRING_IGNORE;
+        }
+
+        /* Delete the old bond. */
         ble_store_util_delete_peer(&desc.peer_id_addr);
 
         /* Return BLE_GAP_REPEAT_PAIRING_RETRY to indicate that the host should
@@ -215,51 +431,27 @@ bleprph_gap_event(struct ble_gap_event *event, void *arg)
 }
 
 /**
- * Enables advertising with the following parameters:
- *     o General discoverable mode.
- *     o Undirected connectable mode.
+ * Encodes the payloads of the undirected phases:
+ *     o Advertisement: flags (general discoverable, BLE only), tx power,
+ *       appearance and the HID service UUID.
+ *     o Scan response: device name, shortened if it does not fit.
  */
-static void
-bleprph_advertise(void)
+static int
+bleprph_adv_encode(const char *name, uint16_t appearance)
 {
-    struct ble_gap_adv_params adv_params;
     struct ble_hs_adv_fields fields;
-    const char *name;
+    size_t name_len = strlen(name);
     int rc;
 
-    /**
-     *  Set the advertisement data included in our advertisements:
-     *     o Flags (indicates advertisement type and other general info).
-     *     o Advertising tx power.
-     *     o Device name.
-     *     o 16-bit service UUIDs (alert notifications).
-     */
-
     memset(&fields, 0, sizeof fields);
-
-    /* Advertise two flags:
-     *     o Discoverability in forthcoming advertisement (general)
-     *     o BLE-only (BR/EDR unsupported).
-     */
     fields.flags = BLE_HS_ADV_F_DISC_GEN |
                    BLE_HS_ADV_F_BREDR_UNSUP;
 
-    /* Indicate that the TX power level field should be included; have the
-     * stack fill this value automatically.  This is done by assigning the
-     * special value BLE_HS_ADV_TX_PWR_LVL_AUTO.
-     */
+    /* The stack reads the level from the controller, once per encoding */
     fields.tx_pwr_lvl_is_present = 1;
     fields.tx_pwr_lvl = BLE_HS_ADV_TX_PWR_LVL_AUTO;
 
-    fields.adv_itvl_is_present = 1;
-    fields.adv_itvl = 40;
-
-    name = ble_svc_gap_device_name();
-    fields.name = (uint8_t *)name;
-    fields.name_len = strlen(name);
-    fields.name_is_complete = 1;
-
-    fields.appearance = ble_svc_gap_device_appearance();
+    fields.appearance = appearance;
     fields.appearance_is_present = 1;
 
     fields.uuids16 = (ble_uuid16_t[]) {
@@ -268,41 +460,256 @@ bleprph_advertise(void)
     fields.num_uuids16 = 1;
     fields.uuids16_is_complete = 1;
 
-    uint8_t buf[50], buf_sz;
-    rc = ble_hs_adv_set_fields(&fields, buf, &buf_sz, 50);
+    rc = ble_hs_adv_set_fields(&fields, adv_data, &adv_data_len, sizeof(adv_data));
     if (rc != 0) {
-        BLE_HID_LOG_ERROR("error setting advertisement data to buf; rc=%d", rc);
-        return;
+        BLE_HID_LOG_ERROR("error encoding advertisement data; rc=%d", rc);
+        return rc;
     }
-    if (buf_sz > BLE_HS_ADV_MAX_SZ) {
-        BLE_HID_LOG_ERROR("Too long advertising data: name %s, appearance %x, uuid16 %x, advsize = %d",
-            name, fields.appearance, GATT_UUID_HID_SERVICE, buf_sz);
-        ble_hs_adv_parse(buf, buf_sz, user_parse, NULL);
-        return;
+
+    memset(&fields, 0, sizeof fields);
+    fields.name = (uint8_t *)name;
+    fields.name_len = name_len > ADV_NAME_MAX_LEN ? ADV_NAME_MAX_LEN : name_len;
+    fields.name_is_complete = name_len <= ADV_NAME_MAX_LEN;
+
+    rc = ble_hs_adv_set_fields(&fields, adv_rsp_data, &adv_rsp_data_len,
+                               sizeof(adv_rsp_data));
+    if (rc != 0) {
+        BLE_HID_LOG_ERROR("error encoding scan response data; rc=%d", rc);
+        return rc;
+    }
+
+    adv_name_len = name_len;
+    adv_appearance = appearance;
+    adv_data_set = false;
+    return 0;
+}
+
+/**
+ * Makes sure the controller has the payloads of the undirected phases.
+ * They are only encoded again when the device name or appearance changed
+ * and only written when the controller lost them.
+ */
+static int
+bleprph_adv_set_data(void)
+{
+    const char *name = ble_svc_gap_device_name();
+    uint16_t appearance = ble_svc_gap_device_appearance();
+    size_t name_len = strlen(name);
+    int rc;
+
+    if (adv_data_len == 0 || appearance != adv_appearance || name_len != adv_name_len ||
+        memcmp(adv_rsp_data + 2, name, adv_rsp_data_len - 2)) {
+        rc = bleprph_adv_encode(name, appearance);
+        if (rc != 0) {
+            return rc;
+        }
     }
 
-    rc = ble_gap_adv_set_fields(&fields);
+    if (adv_data_set) {
+        return 0;
+    }
+
+    rc = ble_gap_adv_set_data(adv_data, adv_data_len);
+    if (rc == 0) {
+        rc = ble_gap_adv_rsp_set_data(adv_rsp_data, adv_rsp_data_len);
+    }
     if (rc != 0) {
         BLE_HID_LOG_ERROR("error setting advertisement data; rc=%d", rc);
-        return;
+        return rc;
     }
 
-    /* Begin advertising. */
+    adv_data_set = true;
+    return 0;
+}
+
+static void
+bleprph_adv_start(int phase)
+{
+    struct ble_gap_adv_params adv_params;
+    const ble_addr_t *direct_addr;
+    int32_t duration_ms;
+    int rc;
+
+    direct_addr = hid_bond_active_peer();
+    if (direct_addr == NULL && phase < ADV_PHASE_FAST) {
+        phase = ADV_PHASE_FAST;
+    }
+    if (phase > ADV_PHASE_SLOW) {
+        phase = ADV_PHASE_SLOW;
+    }
+    adv_phase = phase;
+
     memset(&adv_params, 0, sizeof adv_params);
-    adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
-    adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
-    rc = ble_gap_adv_start(own_addr_type, NULL, BLE_HS_FOREVER,
+
+    switch (phase) {
+    case ADV_PHASE_HD_DIRECTED:
+        adv_params.conn_mode = BLE_GAP_CONN_MODE_DIR;
+        adv_params.high_duty_cycle = 1;
+        duration_ms = MYNEWT_VAL(BLE_HID_ADV_HD_DIR_MS);
+        break;
+
+    case ADV_PHASE_LD_DIRECTED:
+        adv_params.conn_mode = BLE_GAP_CONN_MODE_DIR;
+        adv_params.itvl_min = MYNEWT_VAL(BLE_HID_ADV_LD_DIR_ITVL);
+        adv_params.itvl_max = MYNEWT_VAL(BLE_HID_ADV_LD_DIR_ITVL);
+        duration_ms = MYNEWT_VAL(BLE_HID_ADV_LD_DIR_MS);
+        break;
+
+    case ADV_PHASE_FAST:
+        adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
+        adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
+        adv_params.itvl_min = MYNEWT_VAL(BLE_HID_ADV_FAST_ITVL);
+        adv_params.itvl_max = MYNEWT_VAL(BLE_HID_ADV_FAST_ITVL);
+        direct_addr = NULL;
+        duration_ms = MYNEWT_VAL(BLE_HID_ADV_FAST_MS);
+        break;
+
+    default:
+        adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
+        adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
+        adv_params.itvl_min = MYNEWT_VAL(BLE_HID_ADV_SLOW_ITVL);
+        adv_params.itvl_max = MYNEWT_VAL(BLE_HID_ADV_SLOW_ITVL);
+        direct_addr = NULL;
+        duration_ms = BLE_HS_FOREVER;
+        break;
+    }
+
+    if (direct_addr == NULL) {
+        rc = bleprph_adv_set_data();
+        if (rc != 0) {
+            return;
+        }
+    }
+
+    /* Begin advertising. */
+    rc = ble_gap_adv_start(own_addr_type, direct_addr, duration_ms,
                            &adv_params, bleprph_gap_event, NULL);
     if (rc != 0) {
-        BLE_HID_LOG_ERROR("error enabling advertisement; rc=%d", rc);
+        BLE_HID_LOG_ERROR("error enabling advertisement; phase=%d rc=%d", phase, rc);
         return;
     }
 }
 
+/**
+ * Starts the reconnect sequence, from directed advertising to the last
+ * bonded host down to slow undirected advertising.
+ */
+static void
+bleprph_advertise(void)
+{
+    if (bleprph_sleeping) {
+        return;
+    }
+    adv_start_time = os_time_get();
+    bleprph_adv_start(ADV_PHASE_HD_DIRECTED);
+}
+
+static void
+bleprph_switch_event(struct os_event *ev)
+{
+    int rc;
+
+    if (bleprph_switch_op == SWITCH_OP_UNPAIR) {
+        rc = hid_bond_clear(bleprph_switch_slot);
+        if (rc != 0 || bleprph_switch_slot != hid_bond_active_slot()) {
+            return;
+        }
+    } else {
+        rc = hid_bond_set_active(bleprph_switch_slot);
+        if (rc != 0) {
+            BLE_HID_LOG_ERROR("host switch to slot %d failed; rc=%d\n",
+                              bleprph_switch_slot, rc);
+        }
+        if (bleprph_switch_op == SWITCH_OP_PAIR) {
+            hid_bond_allow_pairing(bleprph_switch_slot);
+        }
+        bleprph_switch_ts = os_cputime_get32();
+        HID_TRACE(HID_TRACE_HOST_SWITCH, bleprph_switch_slot, 0, 0);
+    }
+
+    if (bleprph_conn_handle != BLE_HS_CONN_HANDLE_NONE) {
+        /* advertising for the new slot starts on the disconnect event */
+        ble_gap_terminate(bleprph_conn_handle, BLE_ERR_REM_USER_CONN_TERM);
+    } else {
+        ble_gap_adv_stop();
+        bleprph_advertise();
+        hid_bond_save_active();
+    }
+}
+
+static int
+bleprph_switch_post(int slot, enum bleprph_switch_op op)
+{
+    if (slot < 0 || slot >= MYNEWT_VAL(BLE_HID_BOND_SLOTS)) {
+        return SYS_EINVAL;
+    }
+
+    bleprph_switch_slot = slot;
+    bleprph_switch_op = op;
+    os_eventq_put(hid_host_evq_get(), &bleprph_switch_ev);
+    return 0;
+}
+
+#if MYNEWT_VAL(BLE_HID_RETAIN)
+static void
+bleprph_sleep_event(struct os_event *ev)
+{
+    bleprph_sleeping = true;
+    ble_gap_adv_stop();
+
+    if (bleprph_conn_handle != BLE_HS_CONN_HANDLE_NONE) {
+        /* released on the disconnect event */
+        ble_gap_terminate(bleprph_conn_handle, BLE_ERR_REM_USER_CONN_TERM);
+    } else {
+        hid_bond_save_active();
+        os_sem_release(&bleprph_sleep_sem);
+    }
+}
+
+int
+ble_hid_sleep(uint32_t timeout_ms, const void **ram, size_t *ram_len)
+{
+    os_error_t err;
+
+    *ram = hid_bond_retain(ram_len);
+
+    os_eventq_put(hid_host_evq_get(), &bleprph_sleep_ev);
+    err = os_sem_pend(&bleprph_sleep_sem, os_time_ms_to_ticks32(timeout_ms));
+    return err == OS_OK ? 0 : SYS_ETIMEOUT;
+}
+#endif
+
+int
+ble_hid_host_active(void)
+{
+    return hid_bond_active_slot();
+}
+
+int
+ble_hid_host_switch(int slot)
+{
+    return bleprph_switch_post(slot, SWITCH_OP_SWITCH);
+}
+
+int
+ble_hid_host_pair(int slot)
+{
+    return bleprph_switch_post(slot, SWITCH_OP_PAIR);
+}
+
+int
+ble_hid_host_unpair(int slot)
+{
+    return bleprph_switch_post(slot, SWITCH_OP_UNPAIR);
+}
+
 static void
 bleprph_on_reset(int reason)
 {
     BLE_HID_LOG_ERROR("Resetting state; reason=%d", reason);
+
+    /* the controller lost the advertising payloads */
+    adv_data_set = false;
 }
 
 static void
@@ -326,6 +733,9 @@ bleprph_on_sync(void)
 
     BLE_HID_LOG_INFO("Device Address: "MACSTR "\n", MAC2STR_REV(addr_val));
 
+    /* Encode the payloads once, restarts only re-enable advertising. */
+    bleprph_adv_set_data();
+
     /* Begin advertising. */
     bleprph_advertise();
 }
@@ -334,6 +744,35 @@ void
 ble_hid_init()
 {
     int rc = 0;
+
+    hid_log_init();
+    hid_trace_init();
+    hid_prof_init();
+    hid_func_init();
+
+    rc = stats_init_and_reg(STATS_HDR(hid_link_stats),
+                            STATS_SIZE_INIT_PARMS(hid_link_stats, STATS_SIZE_32),
+                            STATS_NAME_INIT_PARMS(hid_link_stats),
+                            "hid_link");
+    SYSINIT_PANIC_ASSERT(rc == 0);
+
+    hid_conn_gov_init();
+    hid_bond_init();
+#if MYNEWT_VAL(BLE_HID_RETAIN)
+    if (hid_bond_restore()) {
+        BLE_HID_LOG_INFO("System OFF wake, host slot %d restored\n",
+                         hid_bond_active_slot());
+    }
+    bleprph_sleep_ev.ev_cb = bleprph_sleep_event;
+    os_sem_init(&bleprph_sleep_sem, 0);
+#endif
+    hid_phy_init();
+    hid_anchor_init();
+#if MYNEWT_VAL(BLE_HID_BENCH)
+    hid_bench_init();
+#endif
+    bleprph_switch_ev.ev_cb = bleprph_switch_event;
+
     /* Initialize the NimBLE host configuration. */
     ble_hs_cfg.reset_cb = bleprph_on_reset;
     ble_hs_cfg.sync_cb = bleprph_on_sync;
@@ -0,0 +1,62 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <string.h>
+
+#include "os/mynewt.h"
+#include "gatt_svr.h"
+#include "hid_test.h"
+
+size_t
+hid_test_patch_map(uint8_t *map, uint8_t prefix, int n, uint8_t val)
+{
+    static const uint8_t item_size[4] = { 0, 1, 2, 4 };
+    size_t off = 0;
+
+    TEST_ASSERT_FATAL(hid_report_map_size <= HID_TEST_MAP_MAX);
+    memcpy(map, hid_report_map, hid_report_map_size);
+
+    while (off < hid_report_map_size) {
+        if (map[off] == prefix && n-- == 0) {
+            map[off + 1] = val;
+            return hid_report_map_size;
+        }
+        off += 1 + item_size[map[off] & 0x03];
+    }
+
+    TEST_ASSERT_FATAL(0, "item 0x%02x not in the report map", prefix);
+    return 0;
+}
+
+TEST_SUITE(hid_rmap_test_suite)
+{
+    hid_rmap_test_shipped();
+    hid_rmap_test_chunked();
+    hid_rmap_test_truncated();
+    hid_rmap_test_collections();
+    hid_rmap_test_report_id();
+    hid_rmap_test_size();
+}
+
+int
+main(int argc, char **argv)
+{
+    hid_rmap_test_suite();
+
+    return tu_any_failed;
+}
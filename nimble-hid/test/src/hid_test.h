@@ -0,0 +1,45 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef H_HID_TEST_
+#define H_HID_TEST_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "testutil/testutil.h"
+
+/* Largest descriptor a test builds, the shipped map plus a few items */
+#define HID_TEST_MAP_MAX    512
+
+/*
+   Copies the shipped report map to 'map' and changes the value of the
+   n-th (from 0) short item with the given prefix byte.  Walks the items,
+   so data bytes that look like the prefix are not matched.  Returns the
+   map length, asserts if the item does not exist.
+ */
+size_t hid_test_patch_map(uint8_t *map, uint8_t prefix, int n, uint8_t val);
+
+TEST_CASE_DECL(hid_rmap_test_shipped)
+TEST_CASE_DECL(hid_rmap_test_chunked)
+TEST_CASE_DECL(hid_rmap_test_truncated)
+TEST_CASE_DECL(hid_rmap_test_collections)
+TEST_CASE_DECL(hid_rmap_test_report_id)
+TEST_CASE_DECL(hid_rmap_test_size)
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <string.h>
+
+#include "os/mynewt.h"
+#include "defs/error.h"
+#include "gatt_svr.h"
+#include "hid_func.h"
+#include "hid_rmap.h"
+#include "hid_test.h"
+
+/* fed one byte at a time, every item is split across chunks */
+TEST_CASE_SELF(hid_rmap_test_chunked)
+{
+    struct hid_rmap_parser p;
+    struct hid_rmap_info whole;
+    struct hid_rmap_info info;
+    size_t i;
+
+    TEST_ASSERT_FATAL(hid_rmap_parse(hid_report_map, hid_report_map_size, &whole) == 0);
+
+    hid_rmap_parser_init(&p, &info);
+    for (i = 0; i < hid_report_map_size; ++i) {
+        TEST_ASSERT_FATAL(hid_rmap_parser_feed(&p, &hid_report_map[i], 1) == 0);
+    }
+    TEST_ASSERT_FATAL(hid_rmap_parser_finish(&p) == 0);
+
+    TEST_ASSERT(info.num_reports == whole.num_reports);
+    TEST_ASSERT(memcmp(info.reports, whole.reports,
+                       whole.num_reports * sizeof(whole.reports[0])) == 0);
+}
@@ -0,0 +1,48 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include <string.h>
+
+#include "os/mynewt.h"
+#include "defs/error.h"
+#include "gatt_svr.h"
+#include "hid_func.h"
+#include "hid_rmap.h"
+#include "hid_test.h"
+
+TEST_CASE_SELF(hid_rmap_test_collections)
+{
+    static const uint8_t extra_end[] = {
+        0x05, 0x01, 0x09, 0x06, 0xA1, 0x01, 0xC0, 0xC0,
+    };
+    static const uint8_t pop_empty[] = { 0xB4 };
+    uint8_t map[HID_TEST_MAP_MAX];
+    struct hid_rmap_info info;
+
+    /* shipped map without its final End Collection */
+    TEST_ASSERT(hid_rmap_parse(hid_report_map, hid_report_map_size - 1, &info) ==
+                SYS_EINVAL);
+
+    TEST_ASSERT(hid_rmap_parse(extra_end, sizeof(extra_end), &info) == SYS_EINVAL);
+    TEST_ASSERT(hid_rmap_parse(pop_empty, sizeof(pop_empty), &info) == SYS_EINVAL);
+
+    /* the shipped map with one more End Collection */
+    memcpy(map, hid_report_map, hid_report_map_size);
+    map[hid_report_map_size] = 0xC0;
+    TEST_ASSERT(hid_rmap_parse(map, hid_report_map_size + 1, &info) == SYS_EINVAL);
+}
@@ -0,0 +1,55 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "os/mynewt.h"
+#include "defs/error.h"
+#include "gatt_svr.h"
+#include "hid_func.h"
+#include "hid_rmap.h"
+#include "hid_test.h"
+
+/* Report ID items, in map order */
+#define ITEM_REPORT_ID      0x85
+#define RPT_ID_ITEM_KB      1
+
+TEST_CASE_SELF(hid_rmap_test_report_id)
+{
+    /* Report ID 0 is reserved */
+    static const uint8_t id_zero[] = {
+        0x85, 0x01, 0x75, 0x08, 0x95, 0x01, 0x81, 0x02,
+        0x85, 0x00,
+    };
+    /* either every report has an ID or none has */
+    static const uint8_t no_id_then_id[] = {
+        0x75, 0x08, 0x95, 0x01, 0x81, 0x02,
+        0x85, 0x02, 0x81, 0x02,
+    };
+    uint8_t map[HID_TEST_MAP_MAX];
+    struct hid_rmap_info info;
+    size_t len;
+
+    TEST_ASSERT(hid_rmap_parse(id_zero, sizeof(id_zero), &info) == SYS_EINVAL);
+    TEST_ASSERT(hid_rmap_parse(no_id_then_id, sizeof(no_id_then_id), &info) ==
+                SYS_EINVAL);
+
+    /* keyboard under another ID: its references and the boot report are
+     * no longer in the map */
+    len = hid_test_patch_map(map, ITEM_REPORT_ID, RPT_ID_ITEM_KB, 5);
+    TEST_ASSERT(hid_rmap_parse(map, len, &info) == 0);
+    TEST_ASSERT(hid_validate_report_map(map, len) != 0);
+}
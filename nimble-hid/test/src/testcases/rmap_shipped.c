@@ -0,0 +1,49 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "os/mynewt.h"
+#include "defs/error.h"
+#include "gatt_svr.h"
+#include "hid_func.h"
+#include "hid_rmap.h"
+#include "hid_test.h"
+
+TEST_CASE_SELF(hid_rmap_test_shipped)
+{
+    struct hid_rmap_info info;
+    const struct hid_rmap_report *rpt;
+
+    TEST_ASSERT_FATAL(hid_rmap_parse(hid_report_map, hid_report_map_size, &info) == 0);
+
+    /* every report buffer and reference matches the map */
+    TEST_ASSERT(hid_validate_report_map(hid_report_map, hid_report_map_size) == 0);
+
+    rpt = hid_rmap_find(&info, HID_RPT_ID_KB_IN);
+    TEST_ASSERT_FATAL(rpt != NULL);
+    TEST_ASSERT(rpt->boot_flags & HID_RMAP_BOOT_KBD);
+    TEST_ASSERT(hid_rmap_report_len(&info, HID_RPT_ID_KB_IN, HID_REPORT_TYPE_INPUT) == 8);
+    TEST_ASSERT(hid_rmap_report_len(&info, HID_RPT_ID_KB_IN, HID_REPORT_TYPE_OUTPUT) == 1);
+
+    rpt = hid_rmap_find(&info, HID_RPT_ID_MOUSE_IN);
+    TEST_ASSERT_FATAL(rpt != NULL);
+    TEST_ASSERT(rpt->boot_flags & HID_RMAP_BOOT_MOUSE);
+    TEST_ASSERT(hid_rmap_report_len(&info, HID_RPT_ID_MOUSE_IN, HID_REPORT_TYPE_INPUT) == 4);
+
+    TEST_ASSERT(hid_rmap_find(&info, HID_RPT_ID_CC_IN) != NULL);
+    TEST_ASSERT(hid_rmap_report_len(&info, HID_RPT_ID_CC_IN, HID_REPORT_TYPE_OUTPUT) == -1);
+}
@@ -0,0 +1,48 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "os/mynewt.h"
+#include "defs/error.h"
+#include "gatt_svr.h"
+#include "hid_func.h"
+#include "hid_rmap.h"
+#include "hid_test.h"
+
+/* Report Size and Report Count items, in map order */
+#define ITEM_REPORT_SIZE    0x75
+#define ITEM_REPORT_COUNT   0x95
+/* keyboard key array count and LED padding size */
+#define RPT_COUNT_ITEM_KB_KEYS  7
+#define RPT_SIZE_ITEM_KB_PAD    6
+
+TEST_CASE_SELF(hid_rmap_test_size)
+{
+    uint8_t map[HID_TEST_MAP_MAX];
+    struct hid_rmap_info info;
+    size_t len;
+
+    /* seven keys: a valid map, but not the 8 byte keyboard buffer */
+    len = hid_test_patch_map(map, ITEM_REPORT_COUNT, RPT_COUNT_ITEM_KB_KEYS, 7);
+    TEST_ASSERT_FATAL(hid_rmap_parse(map, len, &info) == 0);
+    TEST_ASSERT(hid_rmap_report_len(&info, HID_RPT_ID_KB_IN, HID_REPORT_TYPE_INPUT) == 9);
+    TEST_ASSERT(hid_validate_report_map(map, len) != 0);
+
+    /* LED report of 5 + 4 bits is not a whole number of bytes */
+    len = hid_test_patch_map(map, ITEM_REPORT_SIZE, RPT_SIZE_ITEM_KB_PAD, 4);
+    TEST_ASSERT(hid_rmap_parse(map, len, &info) == SYS_EINVAL);
+}
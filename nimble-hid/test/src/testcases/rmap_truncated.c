@@ -0,0 +1,40 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *  http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+#include "os/mynewt.h"
+#include "defs/error.h"
+#include "gatt_svr.h"
+#include "hid_func.h"
+#include "hid_rmap.h"
+#include "hid_test.h"
+
+TEST_CASE_SELF(hid_rmap_test_truncated)
+{
+    /* Report Size with one of its two data bytes */
+    static const uint8_t short_data[] = { 0x05, 0x01, 0x76, 0x08 };
+    /* long item announcing 4 data bytes, 2 present */
+    static const uint8_t long_data[] = { 0xFE, 0x04, 0x10, 0x00, 0x00 };
+    struct hid_rmap_info info;
+
+    TEST_ASSERT(hid_rmap_parse(short_data, sizeof(short_data), &info) == SYS_EINVAL);
+    TEST_ASSERT(hid_rmap_parse(long_data, sizeof(long_data), &info) == SYS_EINVAL);
+
+    /* cut inside the Input item before the final End Collection */
+    TEST_ASSERT(hid_rmap_parse(hid_report_map, hid_report_map_size - 2, &info) ==
+                SYS_EINVAL);
+}
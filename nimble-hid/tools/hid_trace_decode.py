@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#  http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+
+"""Convert a nimble-hid trace dump into a Chrome trace (chrome://tracing,
+Perfetto) JSON file.
+
+The dump is the concatenation of the "d" byte strings returned by the trace
+SMP group (BLE_HID_TRACE_MGMT_GROUP, command 0), read with increasing "off"
+until "next" stops advancing.  Each event is a little-endian
+struct hid_trace_rec (see include/nimble-hid/hid_trace.h).
+
+With --hlog the dump is read the same way from the binary log group
+(BLE_HID_HLOG_MGMT_GROUP) instead, and printed as text like the "hidlog"
+shell command.  Each record is a little-endian struct hid_log_rec (see
+src/hid_log.h).
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+REC = struct.Struct('<IBBHI')
+
+# tag: (name, track)
+TAGS = {
+    1: ('matrix_edge', 'matrix'),
+    2: ('debounce', 'matrix'),
+    3: ('report_send', 'hid'),
+    4: ('notify_tx', 'hid'),
+    5: ('conn_update', 'link'),
+    6: ('supervision_timeout', 'link'),
+    7: ('connect', 'link'),
+    8: ('disconnect', 'link'),
+    9: ('host_switch', 'link'),
+    10: ('prof', 'hid'),
+}
+
+TRACKS = ['matrix', 'hid', 'link']
+
+HLOG_REC = struct.Struct('<IHHII')
+
+# enum hid_log_id, same formats as hid_log_fmts in hid_log.c
+HLOG_FMTS = {
+    0: 'attr read: attr %04x op %u',
+    1: 'report access: attr %04x handle_num %u op %u',
+    2: 'report read: handle_num %u data %08x%08x',
+    3: 'subscribe: attr %04x reason %u flags %x',
+    4: 'notify set: attr %04x notify %u indicate %u',
+    5: 'notify tx: attr %04x status %u indication %u',
+}
+
+
+def event_args(tag, a8, a16, a32):
+    if tag == 1:
+        return {'row': a8, 'cols': '0x%08x' % a32}
+    if tag == 2:
+        return {'row': a8, 'cols': '0x%08x' % a32, 'bounce': a16}
+    if tag == 3:
+        return {'rc': a8, 'handle_num': a16}
+    if tag == 4:
+        return {'status': a8, 'attr': a16, 'indication': a32}
+    if tag == 5:
+        return {'status': a8, 'itvl_ms': a16 * 1.25,
+                'latency': a32 >> 16, 'timeout_ms': (a32 & 0xffff) * 10}
+    if tag in (6, 7):
+        return {'status': a8, 'conn': a16}
+    if tag == 8:
+        return {'conn': a16, 'reason': a32}
+    if tag == 9:
+        return {'slot': a8, 'done': a32}
+    return {'a8': a8, 'a16': a16, 'a32': a32}
+
+
+def decode(data, tps):
+    events = []
+    wraps = 0
+    last = None
+
+    for pid, name in enumerate(TRACKS):
+        events.append({'name': 'thread_name', 'ph': 'M', 'pid': 0, 'tid': pid,
+                       'args': {'name': name}})
+
+    for off in range(0, len(data) - REC.size + 1, REC.size):
+        ts, tag, a8, a16, a32 = REC.unpack_from(data, off)
+        # cputime is 32 bit, unwrap it
+        if last is not None and ts < last:
+            wraps += 1
+        last = ts
+        us = ((wraps << 32) + ts) * 1e6 / tps
+
+        name, track = TAGS.get(tag, ('tag%d' % tag, 'hid'))
+        args = event_args(tag, a8, a16, a32)
+        events.append({'name': name, 'ph': 'i', 's': 't', 'ts': us, 'pid': 0,
+                       'tid': TRACKS.index(track), 'args': args})
+        if tag == 5:
+            events.append({'name': 'conn_itvl_ms', 'ph': 'C', 'ts': us,
+                           'pid': 0, 'args': {'itvl': args['itvl_ms']}})
+
+    return {'traceEvents': events, 'displayTimeUnit': 'ms'}
+
+
+def decode_hlog(data, tps):
+    lines = []
+    wraps = 0
+    last = None
+
+    for off in range(0, len(data) - HLOG_REC.size + 1, HLOG_REC.size):
+        ts, rid, arg0, arg1, arg2 = HLOG_REC.unpack_from(data, off)
+        if rid not in HLOG_FMTS:
+            continue
+        if last is not None and ts < last:
+            wraps += 1
+        last = ts
+        us = ((wraps << 32) + ts) * 1000000 // tps
+        lines.append('%d: %s' % (us, HLOG_FMTS[rid] % (arg0, arg1, arg2)))
+
+    return lines
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('dump', help='raw trace dump file')
+    parser.add_argument('-o', '--output', help='output JSON file (default stdout)')
+    parser.add_argument('--tps', type=int, default=1000000,
+                        help='cputime ticks per second ("tps" of the read response)')
+    parser.add_argument('--hlog', action='store_true',
+                        help='the dump comes from the binary log group, print it as text')
+    args = parser.parse_args()
+
+    with open(args.dump, 'rb') as f:
+        data = f.read()
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    if args.hlog:
+        for line in decode_hlog(data, args.tps):
+            out.write(line + '\n')
+    else:
+        json.dump(decode(data, args.tps), out)
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == '__main__':
+    main()
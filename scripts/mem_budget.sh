@@ -0,0 +1,72 @@
+#!/bin/sh
+#
+# Licensed to the Apache Software Foundation (ASF) under one
+# or more contributor license agreements.  See the NOTICE file
+# distributed with this work for additional information
+# regarding copyright ownership.  The ASF licenses this file
+# to you under the Apache License, Version 2.0 (the
+# "License"); you may not use this file except in compliance
+# with the License.  You may obtain a copy of the License at
+#
+#  http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an
+# "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+# KIND, either express or implied.  See the License for the
+# specific language governing permissions and limitations
+# under the License.
+#
+
+# Flash and RAM of a built target grouped by component, from "newt size",
+# followed by the largest RAM symbols.  The runtime side (stack high-water
+# marks, pool minimums) is the "mem" shell command of the keyboard app.
+#
+# usage: scripts/mem_budget.sh [target] [symbols]
+
+target=${1:-chelizi}
+nsyms=${2:-20}
+
+newt build "$target" > /dev/null || exit 1
+
+newt size "$target" | awk '
+/^ *[0-9]+ +[0-9]+ +[^ ]+$/ {
+    name = $3
+    if (name ~ /^nimble-hid/)                   grp = "nimble-hid"
+    else if (name ~ /^apps_/)                   grp = "app"
+    else if (name ~ /^@tmk_keyboard/)           grp = "tmk"
+    else if (name ~ /^@apache-mynewt-nimble/)   grp = "nimble"
+    # tinyusb is built through @apache-mynewt-core/hw/usb/tinyusb
+    else if (name ~ /^@tinyusb|_usb_tinyusb/)   grp = "tinyusb"
+    else if (name ~ /^@apache-mynewt-(core|mcumgr)/) grp = "mynewt"
+    else                                        grp = "other"
+    flash[grp] += $1; ram[grp] += $2
+    tflash += $1; tram += $2
+}
+END {
+    printf "%-12s %8s %8s\n", "component", "FLASH", "RAM"
+    n = split("nimble-hid app tmk nimble tinyusb mynewt other", order, " ")
+    for (i = 1; i <= n; i++) {
+        g = order[i]
+        if (g in flash) {
+            printf "%-12s %8d %8d\n", g, flash[g], ram[g]
+        }
+    }
+    printf "%-12s %8d %8d\n", "total", tflash, tram
+}'
+
+elf=$(ls bin/targets/"$target"/app/apps/*/*.elf 2>/dev/null | head -n 1)
+if [ -n "$elf" ]; then
+    echo
+    echo "largest RAM symbols ($elf):"
+    arm-none-eabi-nm -S --size-sort -r "$elf" |
+        awk 'function hex(s,  i, v) {
+                 v = 0
+                 for (i = 1; i <= length(s); i++) {
+                     v = v * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+                 }
+                 return v
+             }
+             $3 ~ /^[bBdD]$/ { printf "%8d %s\n", hex(tolower($2)), $4 }' |
+        head -n "$nsyms"
+fi